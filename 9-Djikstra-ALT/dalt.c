@@ -1,51 +1,125 @@
+// gcc -O2 -march=native -pthread dalt.c -o dalt -lm (AVX2/SSE4.1 if available)
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
 #include <unistd.h>
 #include <time.h>
+#include <math.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE4_1__)
+#include <smmintrin.h>
+#endif
 
 #define infinity 1000000000
+#define EARTH_RADIUS 6371000.0 // meters
+#define SNAPSHOT_MAGIC "DALTGRPH"
+#define SNAPSHOT_VERSION 3
+#define CH_MAGIC "DALTCHGR"
+#define CH_VERSION 2
+#define LANDMARKS_MAGIC "DALTLMRK"
+#define LANDMARKS_VERSION 2
+#define LANDMARKS_MAX 64 // estimateALT keeps a few ints per landmark on the stack
+#define MARK_UNREACHABLE 0xffff
+#define STATIONS_MAGIC "DALTSTAT"
+#define STATIONS_VERSION 2
+#define OUT_BUFFER_SIZE (1 << 16)
 
 enum
 {
     MODE_DJIKSTRA = 0,
     MODE_FUEL = 2,
     MODE_CHARGER = 4,
-    MODE_ALT = 9
+    MODE_ALT = 9,
+    MODE_BIDI = 10,
+    MODE_BIDI_ALT = 11,
+    MODE_ASTAR = 12
 };
 
-typedef struct NodeStruct
+// picked from the extension of the output file, see outputFormat
+enum
 {
-    int nr;
-    char mode;  // 1 byte for space efficiency
-    char *name; // most nodes don't have a name, should not be too expensive
-    int weight;
-    int startDist;
-    int estimateToGoal;
-    bool checked;
-    double lat;
-    double lon;
-    struct EdgeStruct *edgeHead;
-    struct NodeStruct *previous;
-} Node;
-
-typedef struct EdgeStruct
-{
-    Node *to;
-    struct EdgeStruct *next;
-    int weight;
-} Edge;
+    OUTPUT_CSV,
+    OUTPUT_GEOJSON,
+    OUTPUT_POLYLINE
+};
+
+enum
+{
+    LANDMARKS_GIVEN,
+    LANDMARKS_FARTHEST,
+    LANDMARKS_AVOID,
+    LANDMARKS_PLANAR
+};
+
+// ALT only evaluates the landmarks that bound the current query best,
+// the choice is checked again every ALT_RECHECK_INTERVAL checked nodes
+#define ALT_ACTIVE_LANDMARKS 4
+#define ALT_MAX_ACTIVE_LANDMARKS 8
+#define ALT_RECHECK_INTERVAL 1000
+
+bool validate = false; // DALT_VALIDATE, debug checks outside the hot path
+bool radixQueue = false; // DALT_QUEUE=radix, see initSearch
+bool quiet = false;      // no search reports, set by the query server
+double simplifyTolerance = 5; // DALT_SIMPLIFY, meters, 0 writes every route node
+
+// witness searches give up after this many settled nodes and add the
+// shortcut, which is never wrong, only makes the hierarchy larger
+#define CH_WITNESS_SETTLE_LIMIT 500
+
+#define TIGHTNESS_SOURCES 8
+#define TIGHTNESS_TARGETS 100
+
+// uniform grid over lat/lon for snapping coordinates to nodes, longitudes
+// are scaled by cos(lat) so the cells are roughly square,
+// cell r * cols + c holds cellNodes[cellStart[cell]..cellStart[cell + 1])
+typedef struct SpatialIndexStruct
+{
+    double minLat;
+    double minLon;
+    double lonScale;
+    double cellSize; // in scaled degrees
+    int rows;
+    int cols;
+    int *cellStart;
+    int *cellNodes;
+} SpatialIndex;
 
 typedef struct GraphStruct
 {
     int n;
     int k;
     int numNames;
-    Node *nodes;
+    // node data is split by use: searches only read mode (station searches),
+    // nr, names and coordinates are only used for input and output
+    char *mode;  // MODE_FUEL/MODE_CHARGER or 0
+    int *nr;     // node id, differs from the index in reordered snapshots
+    char **name; // NULL for most nodes
+    double *lat;
+    double *lon;
+    // CSR adjacency, edges of node i are [edgeStart[i], edgeStart[i + 1])
+    int *edgeStart;
+    int *edgeTo;
+    int *edgeWeight;
     int m;
-    int *fromMarks; // used as 2d array
-    int *toMarks;   // used as 2d array
+    // landmark distances in steps of markScale, a row of m per node,
+    // MARK_UNREACHABLE where the landmark can't reach or be reached
+    uint16_t *fromMarks;
+    uint16_t *toMarks;
+    int markScale;
+    SpatialIndex *spatial; // NULL until buildSpatialIndex
+    int *internalId;       // node nr -> index, NULL unless reordered
+    double geoScale;       // smallest edge time per great-circle meter, see estimateGeo
 } Graph;
 
 typedef struct RouteStruct
@@ -53,20 +127,189 @@ typedef struct RouteStruct
     int start;
     int destination;
     int numNodes;
-    Node **path; // pointers to graph->nodes[i]
+    int *path;    // node indexes from start to destination
+    int distance; // infinity until the destination is reached
+    int numActive;
+    int activeMarks[ALT_MAX_ACTIVE_LANDMARKS]; // landmarks used by estimateALT
+    int goalFrom[ALT_MAX_ACTIVE_LANDMARKS];    // destination's fromMarks/toMarks
+    int goalTo[ALT_MAX_ACTIVE_LANDMARKS];      // for the active landmarks
+    int startFrom[ALT_MAX_ACTIVE_LANDMARKS];   // same for start, used by
+    int startTo[ALT_MAX_ACTIVE_LANDMARKS];     // bidirectional ALT
 } Route;
 
+// binary graph snapshot, all offsets are from the start of the file
+// sections are 8 byte aligned so they can be used directly from mmap
+typedef struct SnapshotHeaderStruct
+{
+    char magic[8];
+    int32_t version;
+    int32_t n;
+    int32_t k;
+    int32_t numNames;
+    int64_t nameBytes;
+    int64_t latOffset;        // n doubles
+    int64_t lonOffset;        // n doubles
+    int64_t edgeStartOffset;  // n + 1 ints, edges of node i are [start[i], start[i + 1])
+    int64_t edgeToOffset;     // k ints
+    int64_t edgeWeightOffset; // k ints
+    int64_t modeOffset;       // n chars
+    int64_t nameNodeOffset;   // numNames ints, node nr of each name
+    int64_t nameStartOffset;  // numNames ints, offset of each name in the blob
+    int64_t nameBlobOffset;   // nameBytes chars, null terminated names
+    int64_t orderOffset;      // version 2, n ints, node nr of each index, 0 if not reordered
+    double geoScale;          // version 3, Graph.geoScale
+} SnapshotHeader;
+
+// landmark file written by pre, same layout rules as the snapshot, the
+// tables are in the node order of the graph they were computed on, which
+// the checksum pins down, so they can be used straight from mmap
+typedef struct LandmarkHeaderStruct
+{
+    char magic[8];
+    int32_t version;
+    int32_t n;
+    int32_t m;
+    int32_t markScale;
+    uint64_t checksum;      // graphChecksum of the graph
+    int64_t landmarkOffset; // m ints, node nr of each landmark
+    int64_t fromOffset;     // n * m uint16, row of m per node
+    int64_t toOffset;       // n * m uint16
+} LandmarkHeader;
+
+// contraction hierarchy file written by ch-pre, same layout rules as the
+// snapshot, up edges go from a node to higher ranked nodes and down edges
+// are stored at the lower ranked end of an edge coming from a higher node,
+// node indexes are in the order of the graph the checksum was taken of
+typedef struct CHHeaderStruct
+{
+    char magic[8];
+    int32_t version;
+    int32_t n;
+    int32_t upEdges;
+    int32_t downEdges;
+    uint64_t checksum; // graphChecksum of the graph
+    int64_t rankOffset;
+    int64_t upStartOffset;
+    int64_t upToOffset;
+    int64_t upWeightOffset;
+    int64_t upMiddleOffset; // contracted node of a shortcut, -1 for edges
+    int64_t downStartOffset;
+    int64_t downToOffset;
+    int64_t downWeightOffset;
+    int64_t downMiddleOffset;
+} CHHeader;
+
+// nearest station index written by station-pre, for every node the
+// closest fuel station and charger and the driving time to them (-1 and
+// infinity when none can be reached), same layout rules as the snapshot
+typedef struct StationIndexHeaderStruct
+{
+    char magic[8];
+    int32_t version;
+    int32_t n;
+    uint64_t checksum; // graphChecksum of the graph
+    int64_t fuelStationOffset;
+    int64_t fuelDistOffset;
+    int64_t chargerStationOffset;
+    int64_t chargerDistOffset;
+} StationIndexHeader;
+
+typedef struct StationIndexStruct
+{
+    int n;
+    int *fuelStation;
+    int *fuelDist;
+    int *chargerStation;
+    int *chargerDist;
+} StationIndex;
+
+typedef struct CHStruct
+{
+    int n;
+    int *rank;
+    int *upStart;
+    int *upTo;
+    int *upWeight;
+    int *upMiddle;
+    int *downStart;
+    int *downTo; // the higher ranked node the edge comes from
+    int *downWeight;
+    int *downMiddle;
+} CH;
+
+// edge lists used while contracting, middle is -1 for original edges
+typedef struct CHArcStruct
+{
+    int to;
+    int weight;
+    int middle;
+} CHArc;
+
+typedef struct CHListStruct
+{
+    int length;
+    int capacity;
+    CHArc *arcs;
+} CHList;
+
+// keys[x] is the priority of x, position[x] is the index of x in nodes
+// or -1, so every node is queued at most once and its key can be
+// decreased in place
 typedef struct HeapStruct
 {
     int length;
     int *nodes;
+    int *position;
+    int *keys;
+    struct RadixHeapStruct *radix; // used instead of nodes when set
 } Heap;
 
-void heapSwap(int *a, int *b)
+typedef struct RadixEntryStruct
+{
+    int node;
+    unsigned key;
+} RadixEntry;
+
+// radix heap for searches where the extracted keys never decrease,
+// bucket b > 0 holds keys whose highest bit differing from last is b - 1,
+// so an entry only ever moves to lower buckets. a decreased key is pushed
+// again and the old entry is dropped when its key no longer matches
+typedef struct RadixHeapStruct
+{
+    unsigned last;
+    int length[33];
+    int capacity[33];
+    RadixEntry *buckets[33];
+} RadixHeap;
+
+// per-query state, the graph itself is never written while searching so
+// any number of threads can search it with their own context. an entry
+// only counts when stamp[v] matches generation, so searchClear is O(1)
+// and a query only pays for the nodes it touches (see searchTouch)
+typedef struct SearchContextStruct
+{
+    int n;
+    unsigned generation;
+    unsigned *stamp;
+    int *dist;
+    int *key;      // queue priority, dist plus any estimate
+    int *estimate; // ALT estimate or potential, -infinity until computed
+    int *previous; // -1 for the start and unreached nodes
+    bool *settled;
+    Heap *heap;
+    int *order; // nodes in the order they were settled, only if allocated
+    int numSettled;
+} SearchContext;
+
+// swaps two heap entries and keeps their positions up to date
+void heapSwap(Heap *heap, int i, int j)
 {
-    int temp = *a;
-    *a = *b;
-    *b = temp;
+    int a = heap->nodes[i];
+    int b = heap->nodes[j];
+    heap->nodes[i] = b;
+    heap->nodes[j] = a;
+    heap->position[a] = j;
+    heap->position[b] = i;
 }
 
 int heapOver(int i)
@@ -82,142 +325,285 @@ int heapRight(int i)
     return (i + 1) << 1;
 }
 
-void heapPrioUpOrig(Heap *heap, int i, Node *nodes)
+int heapWeight(Heap *heap, int i)
+{
+    return heap->keys[heap->nodes[i]];
+}
+
+void heapPrioUp(Heap *heap, int i)
 {
-    int f;
-    while (i && nodes[heap->nodes[i]].weight <
-                    nodes[heap->nodes[f = heapOver(i)]].weight)
+    int iWeight = heapWeight(heap, i);
+    while (i)
     {
-        heapSwap(&heap->nodes[i], &heap->nodes[f]);
+        int f = heapOver(i);
+        if (iWeight >= heapWeight(heap, f))
+            break;
+        heapSwap(heap, i, f);
         i = f;
     }
 }
 
-void heapPrioUp(Heap *heap, int i, Node *nodes)
+void heapFix(Heap *heap, int i)
 {
-    int f = heapOver(i);
-    int iWeight = nodes[heap->nodes[i]].weight;
-    int fWeight = nodes[heap->nodes[f]].weight;
+    int l = heapLeft(i);
+    int r = l + 1;
+    int m = i;
+    int mWeight = heapWeight(heap, i);
 
-    while (i && iWeight < fWeight)
+    if (l < heap->length && heapWeight(heap, l) < mWeight)
     {
-        heapSwap(&heap->nodes[i], &heap->nodes[f]);
-        i = f;
-        f = heapOver(i);
-        iWeight = nodes[heap->nodes[i]].weight;
-        fWeight = nodes[heap->nodes[f]].weight;
+        m = l;
+        mWeight = heapWeight(heap, l);
+    }
+
+    if (r < heap->length && heapWeight(heap, r) < mWeight)
+    {
+        m = r;
+        mWeight = heapWeight(heap, r);
+    }
+
+    if (m != i)
+    {
+        heapSwap(heap, i, m);
+        heapFix(heap, m);
     }
 }
 
-void heapInsert(Heap *heap, int x, Node *nodes)
+// flips the sign bit so signed keys sort the same way as unsigned ones
+unsigned radixKey(Heap *heap, int x)
 {
-    int i = heap->length++;
-    heap->nodes[i] = x;
-    heapPrioUp(heap, i, nodes);
+    return (unsigned)heap->keys[x] ^ 0x80000000u;
+}
+
+int radixBucket(RadixHeap *radix, unsigned key)
+{
+    return key == radix->last ? 0 : 32 - __builtin_clz(key ^ radix->last);
+}
+
+void radixAdd(RadixHeap *radix, int b, RadixEntry entry)
+{
+    if (radix->length[b] == radix->capacity[b])
+    {
+        radix->capacity[b] = radix->capacity[b] ? radix->capacity[b] * 2 : 16;
+        radix->buckets[b] = realloc(radix->buckets[b], radix->capacity[b] * sizeof(RadixEntry));
+    }
+    radix->buckets[b][radix->length[b]++] = entry;
+}
+
+void radixPush(Heap *heap, int x)
+{
+    unsigned key = radixKey(heap, x);
+    radixAdd(heap->radix, radixBucket(heap->radix, key), (RadixEntry){x, key});
+    heap->length++;
 }
 
-void heapFixOrig(Heap *heap, int i, Node *nodes)
+// moves the smallest live entries to bucket 0 and returns the last of them,
+// stale entries are dropped on the way, -1 when empty
+int radixPeek(Heap *heap)
 {
-    int m = heapLeft(i);
-    if (m < heap->length)
+    RadixHeap *radix = heap->radix;
+    while (heap->length > 0)
     {
-        int h = m + 1;
-        int hWeight = nodes[heap->nodes[h]].weight;
-        int mWeight = nodes[heap->nodes[m]].weight;
+        if (radix->length[0] > 0)
+        {
+            RadixEntry top = radix->buckets[0][radix->length[0] - 1];
+            if (top.key == radixKey(heap, top.node))
+                return top.node;
+            radix->length[0]--;
+            heap->length--;
+            continue;
+        }
 
-        if (h < heap->length && hWeight < mWeight)
+        int b = 1;
+        while (radix->length[b] == 0)
         {
-            m = h;
-            mWeight = hWeight;
+            b++;
         }
 
-        int iWeight = nodes[heap->nodes[i]].weight;
+        RadixEntry *bucket = radix->buckets[b];
+        int count = radix->length[b];
+        radix->length[b] = 0;
+        unsigned min = UINT32_MAX;
+        int live = 0;
+        for (int i = 0; i < count; i++)
+        {
+            if (bucket[i].key != radixKey(heap, bucket[i].node))
+                continue;
+            if (bucket[i].key < min)
+                min = bucket[i].key;
+            bucket[live++] = bucket[i];
+        }
+        heap->length -= count - live;
 
-        if (mWeight < iWeight)
+        // every live entry lands in a lower bucket relative to the new last
+        radix->last = min;
+        for (int i = 0; i < live; i++)
         {
-            heapSwap(&heap->nodes[i], &heap->nodes[m]);
-            heapFixOrig(heap, m, nodes);
+            radixAdd(radix, radixBucket(radix, bucket[i].key), bucket[i]);
         }
     }
+    return -1;
 }
 
-void heapFix(Heap *heap, int i, Node *nodes)
+// the next node without removing it, -1 when empty
+int heapPeek(Heap *heap)
 {
-    int l = heapLeft(i);
-    int r = l + 1;
-    int m;
-
-    int lWeight = nodes[heap->nodes[l]].weight;
-    int iWeight = nodes[heap->nodes[i]].weight;
+    if (heap->radix != NULL)
+        return radixPeek(heap);
+    return heap->length > 0 ? heap->nodes[0] : -1;
+}
 
-    if (l < heap->length && lWeight < iWeight)
-        m = l;
-    else
-        m = i;
+bool heapEmpty(Heap *heap)
+{
+    return heapPeek(heap) < 0;
+}
 
-    int rWeight = nodes[heap->nodes[r]].weight;
-    int mWeight = nodes[heap->nodes[m]].weight;
+bool heapContains(Heap *heap, int x)
+{
+    return heap->position[x] >= 0;
+}
 
-    if (r < heap->length && rWeight < mWeight)
+// x must not be in the heap
+void heapInsert(Heap *heap, int x)
+{
+    if (heap->radix != NULL)
     {
-        m = r;
-        mWeight = rWeight;
+        radixPush(heap, x);
+        return;
     }
 
-    if (m != i)
+    int i = heap->length++;
+    heap->nodes[i] = x;
+    heap->position[x] = i;
+    heapPrioUp(heap, i);
+}
+
+// call after lowering the key of x, inserts x if it isn't queued yet
+void heapDecreaseKey(Heap *heap, int x)
+{
+    if (heap->radix != NULL)
+        radixPush(heap, x);
+    else if (!heapContains(heap, x))
+        heapInsert(heap, x);
+    else
+        heapPrioUp(heap, heap->position[x]);
+}
+
+// call after changing the key of x in either direction
+void heapUpdate(Heap *heap, int x)
+{
+    if (!heapContains(heap, x))
     {
-        heapSwap(&heap->nodes[i], &heap->nodes[m]);
-        heapFix(heap, m, nodes);
+        heapInsert(heap, x);
+        return;
     }
+    int i = heap->position[x];
+    heapPrioUp(heap, i);
+    heapFix(heap, heap->position[x]);
 }
 
-int heapGetMin(Heap *heap, Node *nodes)
+int heapGetMin(Heap *heap)
 {
+    if (heap->radix != NULL)
+    {
+        int min = radixPeek(heap);
+        heap->radix->length[0]--;
+        heap->length--;
+        return min;
+    }
+
     int min = heap->nodes[0];
-    heap->nodes[0] = heap->nodes[--heap->length];
-    heapFix(heap, 0, nodes);
+    heap->position[min] = -1;
+    if (--heap->length > 0)
+    {
+        heap->nodes[0] = heap->nodes[heap->length];
+        heap->position[heap->nodes[0]] = 0;
+        heapFix(heap, 0);
+    }
     return min;
 }
 
-void edgeListInsert(Node *nodes, int from, int to, int weight)
+// empties the heap, only the positions of the remaining entries are reset
+void heapClear(Heap *heap)
 {
-    Edge *edge = calloc(1, sizeof(Edge));
-    edge->to = &nodes[to];
-    edge->next = nodes[from].edgeHead;
-    edge->weight = weight;
-    nodes[from].edgeHead = edge;
-}
+    if (heap->radix != NULL)
+    {
+        memset(heap->radix->length, 0, sizeof(heap->radix->length));
+        heap->radix->last = 0;
+        heap->length = 0;
+        return;
+    }
 
-void initNodeDistances(Graph *graph, int start)
-{
-    for (int i = 0; i < graph->n; i++)
+    for (int i = 0; i < heap->length; i++)
     {
-        graph->nodes[i].weight = infinity;
-        graph->nodes[i].startDist = infinity;
+        heap->position[heap->nodes[i]] = -1;
     }
-    graph->nodes[start].weight = 0;
-    graph->nodes[start].startDist = 0;
+    heap->length = 0;
 }
 
-void resetNodes(Graph *graph, Route *route, int start)
+// counting sort of an edge list into the CSR arrays of graph,
+// edges keep their input order within each node
+void buildEdges(Graph *graph, int from[], int to[], int weight[])
 {
-    initNodeDistances(graph, start);
+    int *edgeStart = calloc(graph->n + 1, sizeof(int));
+    int *edgeTo = malloc(graph->k * sizeof(int));
+    int *edgeWeight = malloc(graph->k * sizeof(int));
+
+    for (int e = 0; e < graph->k; e++)
+    {
+        edgeStart[from[e] + 1]++;
+    }
     for (int i = 0; i < graph->n; i++)
     {
-        graph->nodes[i].checked = false;
-        graph->nodes[i].previous = NULL;
-        graph->nodes[i].estimateToGoal = 0;
+        edgeStart[i + 1] += edgeStart[i];
     }
 
-    if (route->path != NULL)
+    int *fill = malloc(graph->n * sizeof(int));
+    memcpy(fill, edgeStart, graph->n * sizeof(int));
+    for (int e = 0; e < graph->k; e++)
+    {
+        int pos = fill[from[e]]++;
+        edgeTo[pos] = to[e];
+        edgeWeight[pos] = weight[e];
+    }
+    free(fill);
+
+    graph->edgeStart = edgeStart;
+    graph->edgeTo = edgeTo;
+    graph->edgeWeight = edgeWeight;
+}
+
+// haversine distance in meters
+double greatCircle(double lat1, double lon1, double lat2, double lon2)
+{
+    double dLat = (lat2 - lat1) * M_PI / 180;
+    double dLon = (lon2 - lon1) * M_PI / 180;
+    double a = sin(dLat / 2) * sin(dLat / 2) +
+               cos(lat1 * M_PI / 180) * cos(lat2 * M_PI / 180) * sin(dLon / 2) * sin(dLon / 2);
+    return 2 * EARTH_RADIUS * asin(sqrt(fmin(a, 1)));
+}
+
+// the fastest any edge covers ground as the crow flies, taken from the
+// coordinates rather than the road lengths so that the great-circle
+// distance times geoScale can never exceed an edge's time, slightly
+// lowered against rounding
+void computeGeoScale(Graph *graph)
+{
+    double scale = INFINITY;
+    for (int i = 0; i < graph->n; i++)
     {
-        free(route->path);
+        for (int e = graph->edgeStart[i]; e < graph->edgeStart[i + 1]; e++)
+        {
+            int j = graph->edgeTo[e];
+            double meters = greatCircle(graph->lat[i], graph->lon[i], graph->lat[j], graph->lon[j]);
+            if (meters > 0 && graph->edgeWeight[e] / meters < scale)
+                scale = graph->edgeWeight[e] / meters;
+        }
     }
-    route->numNodes = 0;
-    route->path = NULL;
+    graph->geoScale = isinf(scale) ? 0 : scale * (1 - 1e-9);
 }
 
-Graph *readGraph(char nodeFile[], char edgeFile[], char poiFile[], bool reverseGraph)
+Graph *readGraph(char nodeFile[], char edgeFile[], char poiFile[])
 {
     float startTime = (float)clock() / CLOCKS_PER_SEC;
 
@@ -242,7 +628,7 @@ Graph *readGraph(char nodeFile[], char edgeFile[], char poiFile[], bool reverseG
         exit(1);
     }
 
-    Graph *graph = malloc(sizeof(Graph));
+    Graph *graph = calloc(1, sizeof(Graph));
 
     fscanf(fpNodes, "%i\n", &graph->n);
     fscanf(fpEdges, "%i\n", &graph->k);
@@ -251,7 +637,11 @@ Graph *readGraph(char nodeFile[], char edgeFile[], char poiFile[], bool reverseG
            graph->n, graph->k, graph->numNames);
     fflush(stdout);
 
-    graph->nodes = calloc(graph->n, sizeof(Node));
+    graph->mode = calloc(graph->n, sizeof(char));
+    graph->nr = malloc(graph->n * sizeof(int));
+    graph->name = calloc(graph->n, sizeof(char *));
+    graph->lat = malloc(graph->n * sizeof(double));
+    graph->lon = malloc(graph->n * sizeof(double));
 
     // read nodes
     for (int i = 0; i < graph->n; i++)
@@ -259,13 +649,15 @@ Graph *readGraph(char nodeFile[], char edgeFile[], char poiFile[], bool reverseG
         int nr;
         double lat, lon;
         fscanf(fpNodes, "%i %lf %lf\n", &nr, &lat, &lon);
-        Node *node = &graph->nodes[nr];
-        node->nr = nr;
-        node->lat = lat;
-        node->lon = lon;
+        graph->nr[nr] = nr;
+        graph->lat[nr] = lat;
+        graph->lon[nr] = lon;
     }
 
     // read edges
+    int *edgeFrom = malloc(graph->k * sizeof(int));
+    int *edgeTo = malloc(graph->k * sizeof(int));
+    int *edgeWeight = malloc(graph->k * sizeof(int));
     for (int i = 0; i < graph->k; i++)
     {
         int from, to, carTime, length, speedLimit;
@@ -280,11 +672,14 @@ Graph *readGraph(char nodeFile[], char edgeFile[], char poiFile[], bool reverseG
             printf("negative edge %i  ", weight);
         }
 
-        if (reverseGraph)
-            edgeListInsert(graph->nodes, to, from, weight);
-        else
-            edgeListInsert(graph->nodes, from, to, weight);
+        edgeFrom[i] = from;
+        edgeTo[i] = to;
+        edgeWeight[i] = weight;
     }
+    buildEdges(graph, edgeFrom, edgeTo, edgeWeight);
+    free(edgeFrom);
+    free(edgeTo);
+    free(edgeWeight);
 
     // read names and fuel/charger (mode)
     for (int i = 0; i < graph->numNames; i++)
@@ -310,12 +705,13 @@ Graph *readGraph(char nodeFile[], char edgeFile[], char poiFile[], bool reverseG
         }
         int nameLength = strlen(name);
 
-        Node *node = &graph->nodes[nr];
-        node->mode = (char)mode;
-        node->name = calloc(nameLength + 1, sizeof(char));
-        strncpy(node->name, name, nameLength);
+        graph->mode[nr] = (char)mode;
+        graph->name[nr] = calloc(nameLength + 1, sizeof(char));
+        strncpy(graph->name[nr], name, nameLength);
     }
 
+    computeGeoScale(graph);
+
     float endTime = (float)clock() / CLOCKS_PER_SEC;
     float timeElapsed = endTime - startTime;
     printf("\r\33[2K"); // VT100 clear line escape code
@@ -327,537 +723,4518 @@ Graph *readGraph(char nodeFile[], char edgeFile[], char poiFile[], bool reverseG
     return graph;
 }
 
-Route *initRoute(int start, int destination)
-{
-    Route *route = calloc(1, sizeof(Route));
-    route->start = start;
-    route->destination = destination;
-
-    return route;
-}
-
-Heap *initHeap(int n)
+// pads the file to the next 8 byte boundary and returns the offset
+int64_t snapshotAlign(FILE *fp)
 {
-    Heap *heap = calloc(1, sizeof(Heap));
-    heap->nodes = calloc(n, sizeof(int));
-    return heap;
+    int64_t offset = ftell(fp);
+    while (offset % 8 != 0)
+    {
+        fputc(0, fp);
+        offset++;
+    }
+    return offset;
 }
 
-void printDrivingTime(int carTime)
+int64_t snapshotSection(FILE *fp, const void *data, size_t size, size_t count)
 {
-    const int secondsInHour = 3600;
-    int rawSeconds = carTime / 100;
-    int h = rawSeconds / secondsInHour;
-    int remainingSeconds = rawSeconds - (h * secondsInHour);
-    int m = remainingSeconds / 60;
-    int minutesAsSeconds = m * 60;
-    int s = remainingSeconds - minutesAsSeconds;
-    printf("%d:%02d:%02d", h, m, s);
+    int64_t offset = snapshotAlign(fp);
+    fwrite(data, size, count, fp);
+    return offset;
 }
 
-void findPath(Graph *graph, Route *route)
+void writeSnapshot(Graph *graph, char outFile[])
 {
-    int pathLength = 0;
+    float startTime = (float)clock() / CLOCKS_PER_SEC;
 
-    for (Node *node = &graph->nodes[route->destination];
-         node != NULL; node = node->previous)
+    FILE *fpOut = fopen(outFile, "wb");
+    if (fpOut == NULL)
     {
-        pathLength++;
+        perror("Error while opening outfile");
+        exit(1);
     }
 
-    route->numNodes = pathLength;
-    route->path = calloc(route->numNodes, sizeof(Node *));
+    int *nameNode = calloc(graph->numNames, sizeof(int));
+    int *nameStart = calloc(graph->numNames, sizeof(int));
+    int64_t nameBytes = 0;
+    int names = 0;
+    int k = graph->edgeStart[graph->n];
 
-    Node *node = &graph->nodes[route->destination];
-    for (int i = route->numNodes - 1; i >= 0; i--)
+    for (int i = 0; i < graph->n; i++)
     {
-        route->path[i] = node;
-        node = node->previous;
+        if (graph->name[i] != NULL && names < graph->numNames)
+        {
+            nameNode[names] = i;
+            nameStart[names] = nameBytes;
+            nameBytes += strlen(graph->name[i]) + 1;
+            names++;
+        }
     }
-}
 
-void writePath(Route *route, char outFile[])
-{
-    FILE *fpOut = fopen(outFile, "w");
-    if (fpOut == NULL)
+    SnapshotHeader header = {0};
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.n = graph->n;
+    header.k = k;
+    header.numNames = names;
+    header.nameBytes = nameBytes;
+    header.geoScale = graph->geoScale;
+    fwrite(&header, sizeof(header), 1, fpOut);
+
+    header.latOffset = snapshotSection(fpOut, graph->lat, sizeof(double), graph->n);
+    header.lonOffset = snapshotSection(fpOut, graph->lon, sizeof(double), graph->n);
+    header.edgeStartOffset = snapshotSection(fpOut, graph->edgeStart, sizeof(int), graph->n + 1);
+    header.edgeToOffset = snapshotSection(fpOut, graph->edgeTo, sizeof(int), k);
+    header.edgeWeightOffset = snapshotSection(fpOut, graph->edgeWeight, sizeof(int), k);
+    header.modeOffset = snapshotSection(fpOut, graph->mode, sizeof(char), graph->n);
+    header.nameNodeOffset = snapshotSection(fpOut, nameNode, sizeof(int), names);
+    header.nameStartOffset = snapshotSection(fpOut, nameStart, sizeof(int), names);
+    header.nameBlobOffset = snapshotAlign(fpOut);
+    for (int i = 0; i < names; i++)
     {
-        perror("Error while opening outfile");
-        exit(1);
+        char *name = graph->name[nameNode[i]];
+        fwrite(name, sizeof(char), strlen(name) + 1, fpOut);
     }
 
-    char csvColumns[] = "nr,node,latitude,longitude\n";
-    fwrite(csvColumns, strlen(csvColumns), 1, fpOut);
-    // up to 3 chars for negative, 1 dot, 7 decimals, and 1 string termination
-    const int coordLength = 12;
-    const int outputLimit = 2000;
-    int moduloFilter = (route->numNodes / outputLimit) + 1;
+    if (graph->internalId != NULL)
+        header.orderOffset = snapshotSection(fpOut, graph->nr, sizeof(int), graph->n);
 
-    for (int i = 0; i < route->numNodes; i++)
-    {
-        if (i % moduloFilter != 0)
-            continue;
+    // rewrite the header now that the section offsets are known
+    fseek(fpOut, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, fpOut);
+    fclose(fpOut);
 
-        char pathNr[10] = {0};
-        char nodeNr[30] = {0};
-        char lat[coordLength];
-        char lon[coordLength];
-        memset(lat, 0, coordLength);
-        memset(lon, 0, coordLength);
-        snprintf(pathNr, 10, "%i", i + 1);
-        snprintf(nodeNr, 30, "%i", route->path[i]->nr);
-        snprintf(lat, coordLength, "%.7f", route->path[i]->lat);
-        snprintf(lon, coordLength, "%.7f", route->path[i]->lon);
-
-        fwrite(pathNr, sizeof(char), strlen(pathNr), fpOut);
-        fwrite(",", sizeof(char), 1, fpOut);
-        fwrite(nodeNr, sizeof(char), strlen(nodeNr), fpOut);
-        fwrite(",", sizeof(char), 1, fpOut);
-        fwrite(lat, sizeof(char), strlen(lat), fpOut);
-        fwrite(",", sizeof(char), 1, fpOut);
-        fwrite(lon, sizeof(char), strlen(lon), fpOut);
-        fwrite("\n", sizeof(char), 1, fpOut);
-    }
-    printf("coordinates written to %s\n", outFile);
+    free(nameNode);
+    free(nameStart);
+
+    float endTime = (float)clock() / CLOCKS_PER_SEC;
+    float timeElapsed = endTime - startTime;
+    printf("snapshot with %i nodes, %i edges and %i names written to %s in %.2fs\n",
+           graph->n, k, names, outFile, timeElapsed);
 }
 
-int estimateALT(Graph *graph, int goal, int node)
+bool isSnapshot(char file[])
 {
-    int estimate = 0;
+    char magic[8] = {0};
+    FILE *fp = fopen(file, "rb");
+    if (fp == NULL)
+        return false;
 
-    for (int i = 0; i < graph->m; i++)
+    size_t read = fread(magic, sizeof(char), sizeof(magic), fp);
+    fclose(fp);
+    return read == sizeof(magic) && memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) == 0;
+}
+
+// maps a snapshot written by writeSnapshot, names and edges are
+// used straight from the mapped file instead of being parsed
+Graph *loadSnapshot(char file[])
+{
+    float startTime = (float)clock() / CLOCKS_PER_SEC;
+
+    int fd = open(file, O_RDONLY);
+    if (fd < 0)
+    {
+        perror("Error while opening file");
+        exit(1);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(SnapshotHeader))
     {
-        int distanceBehind =
-            (graph->fromMarks + goal * graph->m)[i] -
-            (graph->fromMarks + node * graph->m)[i];
+        fprintf(stderr, "%s is not a graph snapshot\n", file);
+        exit(1);
+    }
 
-        if (distanceBehind > estimate && distanceBehind < infinity)
-            estimate = distanceBehind;
+    char *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        perror("Error while mapping file");
+        exit(1);
+    }
 
-        int distanceAfter =
-            (graph->toMarks + node * graph->m)[i] -
-            (graph->toMarks + goal * graph->m)[i];
+    SnapshotHeader *header = (SnapshotHeader *)data;
+    if (memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version < 1 || header->version > SNAPSHOT_VERSION ||
+        header->nameBlobOffset + header->nameBytes > st.st_size)
+    {
+        fprintf(stderr, "%s: unsupported snapshot (version %i, expected %i)\n",
+                file, header->version, SNAPSHOT_VERSION);
+        exit(1);
+    }
 
-        // if (distanceAfter > estimate && distanceAfter < infinity &&
-        //     (graph->toMarks + node * graph->m)[i] < infinity)
-        //     estimate = distanceAfter;
+    Graph *graph = calloc(1, sizeof(Graph));
+    graph->n = header->n;
+    graph->k = header->k;
+    graph->numNames = header->numNames;
+    printf("n: %i k: %i names: %i\nmapping snapshot...", graph->n, graph->k, graph->numNames);
+    fflush(stdout);
 
-        // debug estimates
-        if ((graph->fromMarks + goal * graph->m)[i] < 0 ||
-            (graph->fromMarks + goal * graph->m)[i] >= infinity)
-        {
-            printf("invalid_estimate1 ");
-        }
-        if ((graph->fromMarks + node * graph->m)[i] < 0 ||
-            (graph->fromMarks + node * graph->m)[i] >= infinity)
+    int *edgeStart = (int *)(data + header->edgeStartOffset);
+    int *edgeTo = (int *)(data + header->edgeToOffset);
+    int *edgeWeight = (int *)(data + header->edgeWeightOffset);
+    int *nameNode = (int *)(data + header->nameNodeOffset);
+    int *nameStart = (int *)(data + header->nameStartOffset);
+    char *nameBlob = data + header->nameBlobOffset;
+
+    // node arrays are used straight from the mapping, they are never modified
+    graph->lat = (double *)(data + header->latOffset);
+    graph->lon = (double *)(data + header->lonOffset);
+    graph->mode = data + header->modeOffset;
+    graph->name = calloc(graph->n, sizeof(char *));
+
+    // a reordered snapshot keeps the original ids as node nr
+    if (header->version >= 2 && header->orderOffset != 0)
+    {
+        graph->nr = (int *)(data + header->orderOffset);
+        graph->internalId = malloc(graph->n * sizeof(int));
+        for (int i = 0; i < graph->n; i++)
         {
-            printf("invalid_estimate2 ");
+            graph->internalId[graph->nr[i]] = i;
         }
-        // if ((graph->toMarks + node * graph->m)[i] < 0 ||
-        //     (graph->toMarks + node * graph->m)[i] >= infinity)
-        // {
-        //     printf("invalid_estimate3: %i node:%i ",
-        //            (graph->toMarks + node * graph->m)[i], node);
-        // }
-        if ((graph->toMarks + goal * graph->m)[i] < 0 ||
-            (graph->toMarks + goal * graph->m)[i] >= infinity)
+    }
+    else
+    {
+        graph->nr = malloc(graph->n * sizeof(int));
+        for (int i = 0; i < graph->n; i++)
         {
-            printf("invalid_estimate4 ");
+            graph->nr[i] = i;
         }
     }
 
-    return estimate;
+    graph->edgeStart = edgeStart;
+    graph->edgeTo = edgeTo;
+    graph->edgeWeight = edgeWeight;
+
+    if (header->version >= 3)
+        graph->geoScale = header->geoScale;
+    else
+        computeGeoScale(graph);
+
+    // names point into the mapping as well
+    for (int i = 0; i < graph->numNames; i++)
+    {
+        graph->name[nameNode[i]] = nameBlob + nameStart[i];
+    }
+
+    float endTime = (float)clock() / CLOCKS_PER_SEC;
+    float timeElapsed = endTime - startTime;
+    printf("\r\33[2K"); // VT100 clear line escape code
+    printf("mapped snapshot in %.2fs\n", timeElapsed);
+    return graph;
 }
 
-// uses Djikstra or ALT (A*, Landmarks, Triangle inequality)
-// to find the shortest path
-// to a destination, all other nodes or the closest gas stations/chargers
-// modes --- 0: djikstra, 2: fuel 4: chargers, 9: ALT
-// route->destination should be < 0 when checking all nodes (stopEarly = false)
-void djikstra(Graph *graph, Route *route,
-              bool stopEarly, char mode, int stations[], int stationsN)
+// wall clock seconds, clock() adds up the cpu time of all threads
+double wallTime()
 {
-    float startTime = (float)clock() / CLOCKS_PER_SEC;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
 
-    printf("\n%s from: %s (%i) to: %s (%i)\n",
-           mode == MODE_ALT ? "ALT" : "Djikstra",
-           graph->nodes[route->start].name,
-           route->start,
-           route->destination < 0 ? "ALL" : graph->nodes[route->destination].name,
-           route->destination);
+// nodeFile can either be noder.txt or a snapshot from convert,
+// edgeFile and poiFile are ignored for snapshots,
+// loading the same files again returns the same graph, so main can snap
+// coordinate arguments before the mode loads its graph
+Graph *loadGraph(char nodeFile[], char edgeFile[], char poiFile[])
+{
+    static Graph *loaded = NULL;
+    static char loadedNodes[256];
+    static char loadedEdges[256];
+    if (loaded != NULL && strcmp(loadedNodes, nodeFile) == 0 && strcmp(loadedEdges, edgeFile) == 0)
+        return loaded;
+
+    loaded = isSnapshot(nodeFile) ? loadSnapshot(nodeFile) : readGraph(nodeFile, edgeFile, poiFile);
+    snprintf(loadedNodes, sizeof(loadedNodes), "%s", nodeFile);
+    snprintf(loadedEdges, sizeof(loadedEdges), "%s", edgeFile);
+    return loaded;
+}
 
-    Heap *heap = initHeap(graph->n);
-    heapInsert(heap, route->start, graph->nodes);
-    int checked = 0;
-    int duplicateNodes = 0;
-    int stationsFound = 0;
+// about two nodes per cell, counting sort of the nodes into their cells
+void buildSpatialIndex(Graph *graph)
+{
+    double startTime = wallTime();
+    SpatialIndex *index = calloc(1, sizeof(SpatialIndex));
 
-    int prevQueueWeight = 0;
-    int queueWeightSmallerCount = 0;
+    double maxLat = graph->lat[0], maxLon = graph->lon[0];
+    index->minLat = maxLat;
+    index->minLon = maxLon;
+    for (int i = 1; i < graph->n; i++)
+    {
+        index->minLat = fmin(index->minLat, graph->lat[i]);
+        index->minLon = fmin(index->minLon, graph->lon[i]);
+        maxLat = fmax(maxLat, graph->lat[i]);
+        maxLon = fmax(maxLon, graph->lon[i]);
+    }
 
-    while (heap->length > 0)
+    index->lonScale = cos((index->minLat + maxLat) / 2 * M_PI / 180);
+    double height = maxLat - index->minLat;
+    double width = (maxLon - index->minLon) * index->lonScale;
+    index->cellSize = sqrt(fmax(height * width, 1e-12) / (graph->n / 2 + 1));
+    index->rows = (int)(height / index->cellSize) + 1;
+    index->cols = (int)(width / index->cellSize) + 1;
+
+    int cells = index->rows * index->cols;
+    int *cell = malloc(graph->n * sizeof(int));
+    index->cellStart = calloc(cells + 1, sizeof(int));
+    index->cellNodes = malloc(graph->n * sizeof(int));
+    for (int i = 0; i < graph->n; i++)
+    {
+        int r = (int)((graph->lat[i] - index->minLat) / index->cellSize);
+        int c = (int)((graph->lon[i] - index->minLon) * index->lonScale / index->cellSize);
+        cell[i] = r * index->cols + c;
+        index->cellStart[cell[i] + 1]++;
+    }
+    for (int c = 0; c < cells; c++)
     {
-        int nodeNr = heapGetMin(heap, graph->nodes);
-        Node *node = &graph->nodes[nodeNr];
+        index->cellStart[c + 1] += index->cellStart[c];
+    }
+    int *fill = malloc(cells * sizeof(int));
+    memcpy(fill, index->cellStart, cells * sizeof(int));
+    for (int i = 0; i < graph->n; i++)
+    {
+        index->cellNodes[fill[cell[i]]++] = i;
+    }
+    free(fill);
+    free(cell);
 
-        // workaround instead of re-prioritizing queue for updated distances
-        // typically ~5% wasted heap insertions
-        if (node->checked)
+    graph->spatial = index;
+    printf("spatial index %ix%i in %.3fms\n", index->rows, index->cols,
+           (wallTime() - startTime) * 1000);
+}
+
+// nearest node by equirectangular distance, searches rings of cells around
+// the cell of lat/lon until the next ring is farther away than the best node
+int snapNode(Graph *graph, double lat, double lon)
+{
+    if (graph->spatial == NULL)
+        buildSpatialIndex(graph);
+    SpatialIndex *index = graph->spatial;
+
+    int row = (int)floor((lat - index->minLat) / index->cellSize);
+    int col = (int)floor((lon - index->minLon) * index->lonScale / index->cellSize);
+    row = row < 0 ? 0 : (row >= index->rows ? index->rows - 1 : row);
+    col = col < 0 ? 0 : (col >= index->cols ? index->cols - 1 : col);
+
+    // the grid uses the mid latitude, distances use the query's own latitude
+    double localScale = fabs(cos(lat * M_PI / 180));
+    double ringScale = fmin(1, localScale / index->lonScale);
+
+    int best = -1;
+    double bestDist = INFINITY;
+    int maxRing = index->rows > index->cols ? index->rows : index->cols;
+    for (int ring = 0; ring <= maxRing; ring++)
+    {
+        for (int r = row - ring; r <= row + ring; r++)
         {
-            duplicateNodes++;
-            continue;
+            if (r < 0 || r >= index->rows)
+                continue;
+            // only the outline of the ring, the inside was searched already
+            int step = r == row - ring || r == row + ring ? 1 : 2 * ring;
+            for (int c = col - ring; c <= col + ring; c += step > 0 ? step : 1)
+            {
+                if (c < 0 || c >= index->cols)
+                    continue;
+                int cell = r * index->cols + c;
+                for (int i = index->cellStart[cell]; i < index->cellStart[cell + 1]; i++)
+                {
+                    int v = index->cellNodes[i];
+                    double dy = graph->lat[v] - lat;
+                    double dx = (graph->lon[v] - lon) * localScale;
+                    double dist = dx * dx + dy * dy;
+                    if (dist < bestDist)
+                    {
+                        bestDist = dist;
+                        best = v;
+                    }
+                }
+            }
         }
 
-        node->checked = true;
-        checked++;
+        // a node outside the ring is a ring away in latitude or in scaled longitude
+        double reach = ring * index->cellSize * ringScale;
+        if (best >= 0 && bestDist <= reach * reach)
+            break;
+    }
+    return best;
+}
 
-        if (node->weight < prevQueueWeight)
-        {
-            printf("queue weight:%i < prevQueueWeight:%i heapLength:%i\n",
-                   node->weight, prevQueueWeight, heap->length);
-            printf("node: %.7f %.7f\n", node->lat, node->lon);
-            printf("prev: %.7f %.7f\n", node->previous->lat, node->previous->lon);
-            queueWeightSmallerCount++;
-        }
-        prevQueueWeight = node->weight;
+// index of the node with the given nr, -1 if there is none
+int graphNode(Graph *graph, long nr)
+{
+    if (nr < 0 || nr >= graph->n)
+        return -1;
+    return graph->internalId != NULL ? graph->internalId[nr] : (int)nr;
+}
 
-        // handle gas stations/chargers
-        if ((mode == MODE_FUEL || mode == MODE_CHARGER) &&
-            node->mode == mode && stationsFound < stationsN)
-        {
-            stations[stationsFound++] = node->nr;
-            if (stationsFound == stationsN)
-            {
-                printf("found %i %s\n",
-                       stationsN, mode == MODE_FUEL ? "gas stations" : "chargers");
-                break;
-            }
+// a node id, or "lat,lon" snapped to the nearest node, -1 if invalid
+int parseNode(Graph *graph, char arg[])
+{
+    double lat, lon;
+    if (strchr(arg, ',') != NULL)
+    {
+        if (sscanf(arg, "%lf,%lf", &lat, &lon) != 2)
+            return -1;
+        return snapNode(graph, lat, lon);
+    }
+
+    char *end;
+    long node = strtol(arg, &end, 10);
+    if (end == arg || *end != '\0')
+        return -1;
+    return graphNode(graph, node);
+}
+
+// transposes the adjacency of graph in one pass, the reverse graph shares
+// the node arrays (modes, ids, names and coordinates) with the forward graph
+Graph *reverseGraph(Graph *graph)
+{
+    float startTime = (float)clock() / CLOCKS_PER_SEC;
+
+    Graph *graphRev = calloc(1, sizeof(Graph));
+    graphRev->n = graph->n;
+    graphRev->k = graph->k;
+    graphRev->numNames = graph->numNames;
+    graphRev->mode = graph->mode;
+    graphRev->nr = graph->nr;
+    graphRev->name = graph->name;
+    graphRev->lat = graph->lat;
+    graphRev->lon = graph->lon;
+    graphRev->internalId = graph->internalId;
+    graphRev->geoScale = graph->geoScale;
+
+    int *edgeFrom = malloc(graph->k * sizeof(int));
+    for (int i = 0; i < graph->n; i++)
+    {
+        for (int e = graph->edgeStart[i]; e < graph->edgeStart[i + 1]; e++)
+        {
+            edgeFrom[e] = i;
+        }
+    }
+    buildEdges(graphRev, graph->edgeTo, edgeFrom, graph->edgeWeight);
+    free(edgeFrom);
+
+    float endTime = (float)clock() / CLOCKS_PER_SEC;
+    float timeElapsed = endTime - startTime;
+    printf("reversed graph in %.2fs\n", timeElapsed);
+    return graphRev;
+}
+
+void convertGraph(char nodeFile[], char edgeFile[], char poiFile[], char outFile[])
+{
+    Graph *graph = readGraph(nodeFile, edgeFile, poiFile);
+    writeSnapshot(graph, outFile);
+    exit(0);
+}
+
+Route *initRoute(int start, int destination)
+{
+    Route *route = calloc(1, sizeof(Route));
+    route->start = start;
+    route->destination = destination;
+    route->distance = infinity;
+
+    return route;
+}
+
+void freeRoute(Route *route)
+{
+    free(route->path);
+    free(route);
+}
+
+// n is the number of nodes that can be keyed, which also bounds the length
+Heap *initHeap(int n, int *keys)
+{
+    Heap *heap = calloc(1, sizeof(Heap));
+    heap->nodes = calloc(n, sizeof(int));
+    heap->position = malloc(n * sizeof(int));
+    memset(heap->position, -1, n * sizeof(int));
+    heap->keys = keys;
+    return heap;
+}
+
+// radix heap with the same interface, only for monotone searches:
+// no key may drop below the last extracted one and heapUpdate can't be used
+Heap *initRadixHeap(int *keys)
+{
+    Heap *heap = calloc(1, sizeof(Heap));
+    heap->radix = calloc(1, sizeof(RadixHeap));
+    heap->keys = keys;
+    return heap;
+}
+
+void freeHeap(Heap *heap)
+{
+    if (heap->radix != NULL)
+    {
+        for (int b = 0; b < 33; b++)
+        {
+            free(heap->radix->buckets[b]);
+        }
+        free(heap->radix);
+    }
+    free(heap->nodes);
+    free(heap->position);
+    free(heap);
+}
+
+// DALT_QUEUE=radix gives every search a radix heap instead of the binary heap
+SearchContext *initSearch(Graph *graph)
+{
+    SearchContext *search = calloc(1, sizeof(SearchContext));
+    search->n = graph->n;
+    search->stamp = calloc(graph->n, sizeof(unsigned));
+    search->dist = malloc(graph->n * sizeof(int));
+    search->key = malloc(graph->n * sizeof(int));
+    search->estimate = malloc(graph->n * sizeof(int));
+    search->previous = malloc(graph->n * sizeof(int));
+    search->settled = malloc(graph->n * sizeof(bool));
+    search->heap = radixQueue ? initRadixHeap(search->key) : initHeap(graph->n, search->key);
+    return search;
+}
+
+void freeSearch(SearchContext *search)
+{
+    freeHeap(search->heap);
+    free(search->stamp);
+    free(search->dist);
+    free(search->key);
+    free(search->estimate);
+    free(search->previous);
+    free(search->settled);
+    free(search->order);
+    free(search);
+}
+
+// searches whose keys can drop below the last extracted one (ALT, where
+// landmark updates and rounded landmark distances reopen nodes) can't use
+// the radix heap
+void searchUseBinaryHeap(SearchContext *search)
+{
+    if (search->heap->radix == NULL)
+        return;
+    freeHeap(search->heap);
+    search->heap = initHeap(search->n, search->key);
+}
+
+// starts a new query, everything touched by the last one becomes stale
+void searchClear(SearchContext *search)
+{
+    if (++search->generation == 0)
+    {
+        memset(search->stamp, 0, search->n * sizeof(unsigned));
+        search->generation = 1;
+    }
+    heapClear(search->heap);
+    search->numSettled = 0;
+}
+
+// resets the entry of v if it was left over from an earlier query
+void searchTouch(SearchContext *search, int v)
+{
+    if (search->stamp[v] == search->generation)
+        return;
+
+    search->stamp[v] = search->generation;
+    search->dist[v] = infinity;
+    search->key[v] = infinity;
+    search->estimate[v] = -infinity;
+    search->previous[v] = -1;
+    search->settled[v] = false;
+}
+
+int searchDist(SearchContext *search, int v)
+{
+    return search->stamp[v] == search->generation ? search->dist[v] : infinity;
+}
+
+bool searchSettled(SearchContext *search, int v)
+{
+    return search->stamp[v] == search->generation && search->settled[v];
+}
+
+// queues v with distance 0, key is its priority (0 without an estimate)
+void searchSource(SearchContext *search, int v, int key)
+{
+    searchTouch(search, v);
+    search->dist[v] = 0;
+    search->key[v] = key;
+    heapInsert(search->heap, v);
+}
+
+void formatDrivingTime(char buffer[], int size, int carTime)
+{
+    const int secondsInHour = 3600;
+    int rawSeconds = carTime / 100;
+    int h = rawSeconds / secondsInHour;
+    int remainingSeconds = rawSeconds - (h * secondsInHour);
+    int m = remainingSeconds / 60;
+    int minutesAsSeconds = m * 60;
+    int s = remainingSeconds - minutesAsSeconds;
+    snprintf(buffer, size, "%d:%02d:%02d", h, m, s);
+}
+
+void printDrivingTime(int carTime)
+{
+    char buffer[32];
+    formatDrivingTime(buffer, sizeof(buffer), carTime);
+    printf("%s", buffer);
+}
+
+void findPath(SearchContext *search, Route *route)
+{
+    int pathLength = 0;
+
+    for (int v = route->destination; v >= 0; v = search->previous[v])
+    {
+        pathLength++;
+    }
+
+    route->numNodes = pathLength;
+    route->path = calloc(route->numNodes, sizeof(int));
+
+    int v = route->destination;
+    for (int i = route->numNodes - 1; i >= 0; i--)
+    {
+        route->path[i] = v;
+        v = search->previous[v];
+    }
+}
+
+// buffered writer for the path, station and node outputs, the numbers are
+// formatted by hand, snprintf per field dominated writing long routes
+typedef struct OutBufferStruct
+{
+    FILE *fp;
+    int length;
+    char data[OUT_BUFFER_SIZE];
+} OutBuffer;
+
+// .geojson or .json for GeoJSON, .polyline for an encoded polyline, csv otherwise
+int outputFormat(char outFile[])
+{
+    char *extension = strrchr(outFile, '.');
+    if (extension == NULL)
+        return OUTPUT_CSV;
+    if (strcmp(extension, ".geojson") == 0 || strcmp(extension, ".json") == 0)
+        return OUTPUT_GEOJSON;
+    if (strcmp(extension, ".polyline") == 0)
+        return OUTPUT_POLYLINE;
+    return OUTPUT_CSV;
+}
+
+OutBuffer *initOutput(FILE *fp)
+{
+    OutBuffer *out = malloc(sizeof(OutBuffer));
+    out->fp = fp;
+    out->length = 0;
+    return out;
+}
+
+OutBuffer *openOutput(char outFile[])
+{
+    FILE *fpOut = fopen(outFile, "w");
+    if (fpOut == NULL)
+    {
+        perror("Error while opening outfile");
+        exit(1);
+    }
+    return initOutput(fpOut);
+}
+
+void outFlush(OutBuffer *out)
+{
+    if (out->length > 0 && fwrite(out->data, 1, out->length, out->fp) != (size_t)out->length)
+    {
+        perror("Error while writing outfile");
+        exit(1);
+    }
+    out->length = 0;
+}
+
+void closeOutput(OutBuffer *out)
+{
+    outFlush(out);
+    if (fclose(out->fp) != 0)
+    {
+        perror("Error while writing outfile");
+        exit(1);
+    }
+    free(out);
+}
+
+// makes room for length bytes
+void outReserve(OutBuffer *out, int length)
+{
+    if (out->length + length > OUT_BUFFER_SIZE)
+        outFlush(out);
+}
+
+void outChar(OutBuffer *out, char c)
+{
+    outReserve(out, 1);
+    out->data[out->length++] = c;
+}
+
+void outString(OutBuffer *out, const char *string)
+{
+    int length = strlen(string);
+    outReserve(out, length);
+    if (length > OUT_BUFFER_SIZE)
+    {
+        fwrite(string, 1, length, out->fp);
+        return;
+    }
+    memcpy(out->data + out->length, string, length);
+    out->length += length;
+}
+
+void outInt(OutBuffer *out, long value)
+{
+    outReserve(out, 21);
+    unsigned long digits = value < 0 ? -(unsigned long)value : (unsigned long)value;
+    if (value < 0)
+        out->data[out->length++] = '-';
+
+    char reversed[20];
+    int k = 0;
+    do
+    {
+        reversed[k++] = '0' + digits % 10;
+        digits /= 10;
+    } while (digits > 0);
+    while (k > 0)
+        out->data[out->length++] = reversed[--k];
+}
+
+// like printf's %.<decimals>f for coordinates, up to 9 decimals, a value
+// exactly halfway between two outputs may round the other way
+void outFixed(OutBuffer *out, double value, int decimals)
+{
+    static const long scales[] = {1, 10, 100, 1000, 10000, 100000, 1000000,
+                                  10000000, 100000000, 1000000000};
+    long units = lround(fabs(value) * scales[decimals]);
+    if (value < 0 && units > 0)
+        outChar(out, '-');
+    outInt(out, units / scales[decimals]);
+    if (decimals == 0)
+        return;
+
+    outReserve(out, decimals + 1);
+    out->data[out->length++] = '.';
+    long fraction = units % scales[decimals];
+    for (int k = decimals - 1; k >= 0; k--)
+    {
+        out->data[out->length + k] = '0' + fraction % 10;
+        fraction /= 10;
+    }
+    out->length += decimals;
+}
+
+// one value of Google's encoded polyline format, zig-zag signed and
+// written in 5 bit chunks offset to printable characters
+void outPolylineValue(OutBuffer *out, long value)
+{
+    unsigned long bits = (unsigned long)value << 1;
+    if (value < 0)
+        bits = ~bits;
+
+    outReserve(out, 13);
+    while (bits >= 0x20)
+    {
+        out->data[out->length++] = (char)((0x20 | (bits & 0x1f)) + 63);
+        bits >>= 5;
+    }
+    out->data[out->length++] = (char)(bits + 63);
+}
+
+// the nodes as an encoded polyline with 5 decimals, keep may be NULL for all
+void outPolyline(OutBuffer *out, Graph *graph, int nodes[], bool keep[], int n)
+{
+    long lastLat = 0, lastLon = 0;
+    for (int i = 0; i < n; i++)
+    {
+        if (keep != NULL && !keep[i])
+            continue;
+        long lat = lround(graph->lat[nodes[i]] * 1e5);
+        long lon = lround(graph->lon[nodes[i]] * 1e5);
+        outPolylineValue(out, lat - lastLat);
+        outPolylineValue(out, lon - lastLon);
+        lastLat = lat;
+        lastLon = lon;
+    }
+}
+
+// Douglas-Peucker, marks the path nodes that are kept when every dropped
+// node is within tolerance meters of the simplified line, on an
+// equirectangular projection around the start which is exact enough at
+// route scale, returns the number of kept nodes
+int simplifyPath(Graph *graph, int path[], int numNodes, double tolerance, bool keep[])
+{
+    if (tolerance <= 0 || numNodes < 3)
+    {
+        for (int i = 0; i < numNodes; i++)
+            keep[i] = true;
+        return numNodes;
+    }
+
+    double metersPerDegree = EARTH_RADIUS * M_PI / 180;
+    double lonScale = cos(graph->lat[path[0]] * M_PI / 180) * metersPerDegree;
+    double *x = malloc(numNodes * sizeof(double));
+    double *y = malloc(numNodes * sizeof(double));
+    for (int i = 0; i < numNodes; i++)
+    {
+        x[i] = graph->lon[path[i]] * lonScale;
+        y[i] = graph->lat[path[i]] * metersPerDegree;
+        keep[i] = false;
+    }
+    keep[0] = true;
+    keep[numNodes - 1] = true;
+    int kept = 2;
+
+    // pending (first, last) segments, at most one per kept node
+    int *stack = malloc(2 * numNodes * sizeof(int));
+    int top = 0;
+    stack[top++] = 0;
+    stack[top++] = numNodes - 1;
+    while (top > 0)
+    {
+        int last = stack[--top];
+        int first = stack[--top];
+        double dx = x[last] - x[first];
+        double dy = y[last] - y[first];
+        double length2 = dx * dx + dy * dy;
+
+        int farthest = -1;
+        double farthest2 = tolerance * tolerance;
+        for (int i = first + 1; i < last; i++)
+        {
+            double px = x[i] - x[first];
+            double py = y[i] - y[first];
+            if (length2 > 0)
+            {
+                double t = (px * dx + py * dy) / length2;
+                t = t < 0 ? 0 : (t > 1 ? 1 : t);
+                px -= t * dx;
+                py -= t * dy;
+            }
+            double distance2 = px * px + py * py;
+            if (distance2 > farthest2)
+            {
+                farthest2 = distance2;
+                farthest = i;
+            }
+        }
+
+        if (farthest >= 0)
+        {
+            keep[farthest] = true;
+            kept++;
+            stack[top++] = first;
+            stack[top++] = farthest;
+            stack[top++] = farthest;
+            stack[top++] = last;
+        }
+    }
+
+    free(x);
+    free(y);
+    free(stack);
+    return kept;
+}
+
+// the route simplified to simplifyTolerance, as csv, a GeoJSON LineString
+// feature or an encoded polyline depending on outputFormat
+void writePath(Graph *graph, Route *route, char outFile[])
+{
+    int format = outputFormat(outFile);
+    bool *keep = malloc(route->numNodes * sizeof(bool));
+    int kept = simplifyPath(graph, route->path, route->numNodes, simplifyTolerance, keep);
+    OutBuffer *out = openOutput(outFile);
+
+    if (format == OUTPUT_POLYLINE)
+    {
+        outPolyline(out, graph, route->path, keep, route->numNodes);
+        outChar(out, '\n');
+    }
+    else if (format == OUTPUT_GEOJSON)
+    {
+        outString(out, "{\"type\":\"Feature\",\"properties\":{\"distance\":");
+        outInt(out, route->distance);
+        outString(out, ",\"nodes\":");
+        outInt(out, route->numNodes);
+        outString(out, "},\"geometry\":{\"type\":\"LineString\",\"coordinates\":[");
+        bool first = true;
+        for (int i = 0; i < route->numNodes; i++)
+        {
+            if (!keep[i])
+                continue;
+            outString(out, first ? "[" : ",[");
+            outFixed(out, graph->lon[route->path[i]], 7);
+            outChar(out, ',');
+            outFixed(out, graph->lat[route->path[i]], 7);
+            outChar(out, ']');
+            first = false;
+        }
+        outString(out, "]}}\n");
+    }
+    else
+    {
+        outString(out, "nr,node,latitude,longitude\n");
+        for (int i = 0; i < route->numNodes; i++)
+        {
+            if (!keep[i])
+                continue;
+            outInt(out, i + 1);
+            outChar(out, ',');
+            outInt(out, graph->nr[route->path[i]]);
+            outChar(out, ',');
+            outFixed(out, graph->lat[route->path[i]], 7);
+            outChar(out, ',');
+            outFixed(out, graph->lon[route->path[i]], 7);
+            outChar(out, '\n');
+        }
+    }
+
+    closeOutput(out);
+    free(keep);
+    printf("%i of %i coordinates written to %s\n", kept, route->numNodes, outFile);
+}
+
+// a stored landmark distance only says the true one is in
+// [mark * markScale, mark * markScale + markScale - 1], the bounds take the
+// low end for the added term and the high end for the subtracted one so
+// they stay admissible
+int markLow(Graph *graph, uint16_t mark)
+{
+    return mark == MARK_UNREACHABLE ? infinity : mark * graph->markScale;
+}
+
+int markHigh(Graph *graph, uint16_t mark)
+{
+    return mark == MARK_UNREACHABLE ? infinity : mark * graph->markScale + graph->markScale - 1;
+}
+
+// lower bound for the distance from node to goal given by landmark i,
+// the larger of the bounds through fromMarks and toMarks
+int landmarkBound(Graph *graph, int i, int goal, int node)
+{
+    int goalFrom = markLow(graph, (graph->fromMarks + goal * graph->m)[i]);
+    int nodeFrom = markHigh(graph, (graph->fromMarks + node * graph->m)[i]);
+    int goalTo = markHigh(graph, (graph->toMarks + goal * graph->m)[i]);
+    int nodeTo = markLow(graph, (graph->toMarks + node * graph->m)[i]);
+    int bound = 0;
+
+    if (goalFrom < infinity && nodeFrom < infinity && goalFrom - nodeFrom > bound)
+        bound = goalFrom - nodeFrom;
+    if (goalTo < infinity && nodeTo < infinity && nodeTo - goalTo > bound)
+        bound = nodeTo - goalTo;
+    return bound;
+}
+
+// max over count landmarks of both triangle inequality bounds,
+// distanceBehind = goalFrom - nodeFrom and distanceAfter = nodeTo - goalTo,
+// landmarks that can't reach or be reached by node or goal are masked out
+int altKernel(const int goalFrom[], const int goalTo[],
+              const int nodeFrom[], const int nodeTo[], int count)
+{
+    int estimate = 0;
+    int i = 0;
+
+#if defined(__AVX2__)
+    __m256i inf = _mm256_set1_epi32(infinity);
+    __m256i best = _mm256_setzero_si256();
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i gf = _mm256_loadu_si256((const __m256i *)(goalFrom + i));
+        __m256i nf = _mm256_loadu_si256((const __m256i *)(nodeFrom + i));
+        __m256i gt = _mm256_loadu_si256((const __m256i *)(goalTo + i));
+        __m256i nt = _mm256_loadu_si256((const __m256i *)(nodeTo + i));
+
+        __m256i behindValid = _mm256_and_si256(_mm256_cmpgt_epi32(inf, gf),
+                                               _mm256_cmpgt_epi32(inf, nf));
+        __m256i afterValid = _mm256_and_si256(_mm256_cmpgt_epi32(inf, gt),
+                                              _mm256_cmpgt_epi32(inf, nt));
+        __m256i behind = _mm256_and_si256(_mm256_sub_epi32(gf, nf), behindValid);
+        __m256i after = _mm256_and_si256(_mm256_sub_epi32(nt, gt), afterValid);
+        best = _mm256_max_epi32(best, _mm256_max_epi32(behind, after));
+    }
+    __m128i best4 = _mm_max_epi32(_mm256_castsi256_si128(best),
+                                  _mm256_extracti128_si256(best, 1));
+    best4 = _mm_max_epi32(best4, _mm_shuffle_epi32(best4, _MM_SHUFFLE(1, 0, 3, 2)));
+    best4 = _mm_max_epi32(best4, _mm_shuffle_epi32(best4, _MM_SHUFFLE(2, 3, 0, 1)));
+    estimate = _mm_cvtsi128_si32(best4);
+#elif defined(__SSE4_1__)
+    __m128i inf = _mm_set1_epi32(infinity);
+    __m128i best = _mm_setzero_si128();
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i gf = _mm_loadu_si128((const __m128i *)(goalFrom + i));
+        __m128i nf = _mm_loadu_si128((const __m128i *)(nodeFrom + i));
+        __m128i gt = _mm_loadu_si128((const __m128i *)(goalTo + i));
+        __m128i nt = _mm_loadu_si128((const __m128i *)(nodeTo + i));
+
+        __m128i behindValid = _mm_and_si128(_mm_cmplt_epi32(gf, inf), _mm_cmplt_epi32(nf, inf));
+        __m128i afterValid = _mm_and_si128(_mm_cmplt_epi32(gt, inf), _mm_cmplt_epi32(nt, inf));
+        __m128i behind = _mm_and_si128(_mm_sub_epi32(gf, nf), behindValid);
+        __m128i after = _mm_and_si128(_mm_sub_epi32(nt, gt), afterValid);
+        best = _mm_max_epi32(best, _mm_max_epi32(behind, after));
+    }
+    best = _mm_max_epi32(best, _mm_shuffle_epi32(best, _MM_SHUFFLE(1, 0, 3, 2)));
+    best = _mm_max_epi32(best, _mm_shuffle_epi32(best, _MM_SHUFFLE(2, 3, 0, 1)));
+    estimate = _mm_cvtsi128_si32(best);
+#endif
+
+    for (; i < count; i++)
+    {
+        if (goalFrom[i] < infinity && nodeFrom[i] < infinity &&
+            goalFrom[i] - nodeFrom[i] > estimate)
+            estimate = goalFrom[i] - nodeFrom[i];
+        if (goalTo[i] < infinity && nodeTo[i] < infinity &&
+            nodeTo[i] - goalTo[i] > estimate)
+            estimate = nodeTo[i] - goalTo[i];
+    }
+
+    return estimate;
+}
+
+// active holds the landmarks to use, all graph->m landmarks when NULL
+int estimateALT(Graph *graph, int goal, int node, int active[], int numActive)
+{
+    uint16_t *goalFrom = graph->fromMarks + goal * graph->m;
+    uint16_t *goalTo = graph->toMarks + goal * graph->m;
+    uint16_t *nodeFrom = graph->fromMarks + node * graph->m;
+    uint16_t *nodeTo = graph->toMarks + node * graph->m;
+
+    int count = active == NULL ? graph->m : numActive;
+    int gf[count], gt[count], nf[count], nt[count];
+    for (int a = 0; a < count; a++)
+    {
+        int i = active == NULL ? a : active[a];
+        gf[a] = markLow(graph, goalFrom[i]);
+        gt[a] = markHigh(graph, goalTo[i]);
+        nf[a] = markHigh(graph, nodeFrom[i]);
+        nt[a] = markLow(graph, nodeTo[i]);
+    }
+    return altKernel(gf, gt, nf, nt, count);
+}
+
+// copies the start's and goal's distances for the active landmarks into
+// the route, unused slots are 0 so they never give a bound
+void packRouteMarks(Graph *graph, Route *route)
+{
+    for (int a = 0; a < ALT_MAX_ACTIVE_LANDMARKS; a++)
+    {
+        int i = a < route->numActive ? route->activeMarks[a] : -1;
+        uint16_t *goalFrom = graph->fromMarks + route->destination * graph->m;
+        uint16_t *goalTo = graph->toMarks + route->destination * graph->m;
+        uint16_t *startFrom = graph->fromMarks + route->start * graph->m;
+        uint16_t *startTo = graph->toMarks + route->start * graph->m;
+        route->goalFrom[a] = i < 0 ? 0 : markLow(graph, goalFrom[i]);
+        route->goalTo[a] = i < 0 ? 0 : markHigh(graph, goalTo[i]);
+        route->startFrom[a] = i < 0 ? 0 : markHigh(graph, startFrom[i]);
+        route->startTo[a] = i < 0 ? 0 : markLow(graph, startTo[i]);
+    }
+}
+
+// hot path of ALT, the goal side is already packed by packRouteMarks so only
+// the node's distances are gathered, always a full ALT_MAX_ACTIVE_LANDMARKS
+// wide so the kernel runs without a scalar tail
+int estimateRoute(Graph *graph, Route *route, int node)
+{
+    uint16_t *nodeFrom = graph->fromMarks + node * graph->m;
+    uint16_t *nodeTo = graph->toMarks + node * graph->m;
+    int nf[ALT_MAX_ACTIVE_LANDMARKS] = {0};
+    int nt[ALT_MAX_ACTIVE_LANDMARKS] = {0};
+
+    for (int a = 0; a < route->numActive; a++)
+    {
+        nf[a] = markHigh(graph, nodeFrom[route->activeMarks[a]]);
+        nt[a] = markLow(graph, nodeTo[route->activeMarks[a]]);
+    }
+    return altKernel(route->goalFrom, route->goalTo, nf, nt, ALT_MAX_ACTIVE_LANDMARKS);
+}
+
+// lower bound for the distance from route->start to node, node takes the
+// goal side of the kernel and the packed start the node side
+int estimateFromStart(Graph *graph, Route *route, int node)
+{
+    uint16_t *nodeFrom = graph->fromMarks + node * graph->m;
+    uint16_t *nodeTo = graph->toMarks + node * graph->m;
+    int nf[ALT_MAX_ACTIVE_LANDMARKS] = {0};
+    int nt[ALT_MAX_ACTIVE_LANDMARKS] = {0};
+
+    for (int a = 0; a < route->numActive; a++)
+    {
+        nf[a] = markLow(graph, nodeFrom[route->activeMarks[a]]);
+        nt[a] = markHigh(graph, nodeTo[route->activeMarks[a]]);
+    }
+    return altKernel(nf, nt, route->startFrom, route->startTo, ALT_MAX_ACTIVE_LANDMARKS);
+}
+
+// lower bound for the time from node to goal without any preprocessing,
+// consistent because no edge is faster than geoScale
+int estimateGeo(Graph *graph, int goal, int node)
+{
+    double meters = greatCircle(graph->lat[node], graph->lon[node], graph->lat[goal], graph->lon[goal]);
+    return (int)(meters * graph->geoScale);
+}
+
+// DALT_VALIDATE=1 checks every estimate against the scalar bounds and
+// reports landmark distances that are unreachable
+void validateEstimate(Graph *graph, Route *route, int node, int estimate)
+{
+    int goal = route->destination;
+    int expected = 0;
+
+    for (int a = 0; a < route->numActive; a++)
+    {
+        int i = route->activeMarks[a];
+        int bound = landmarkBound(graph, i, goal, node);
+        if (bound > expected)
+            expected = bound;
+
+        if ((graph->fromMarks + goal * graph->m)[i] == MARK_UNREACHABLE)
+        {
+            printf("invalid_estimate1 ");
+        }
+        if ((graph->fromMarks + node * graph->m)[i] == MARK_UNREACHABLE)
+        {
+            printf("invalid_estimate2 ");
+        }
+        if ((graph->toMarks + node * graph->m)[i] == MARK_UNREACHABLE)
+        {
+            printf("invalid_estimate3 node:%i ", node);
+        }
+        if ((graph->toMarks + goal * graph->m)[i] == MARK_UNREACHABLE)
+        {
+            printf("invalid_estimate4 ");
+        }
+    }
+
+    if (estimate < 0)
+        printf("estimateALT returned negative  ");
+    if (estimate != expected)
+        printf("estimate %i != scalar bound %i node:%i ", estimate, expected, node);
+}
+
+// picks the ALT_ACTIVE_LANDMARKS landmarks with the best bounds from start
+// to route->destination
+void chooseLandmarks(Graph *graph, Route *route, int start)
+{
+    route->numActive = 0;
+    int wanted = graph->m < ALT_ACTIVE_LANDMARKS ? graph->m : ALT_ACTIVE_LANDMARKS;
+
+    while (route->numActive < wanted)
+    {
+        int best = -1;
+        int bestBound = -1;
+        for (int i = 0; i < graph->m; i++)
+        {
+            bool active = false;
+            for (int a = 0; a < route->numActive; a++)
+            {
+                active = active || route->activeMarks[a] == i;
+            }
+
+            int bound = landmarkBound(graph, i, route->destination, start);
+            if (!active && bound > bestBound)
+            {
+                best = i;
+                bestBound = bound;
+            }
+        }
+        route->activeMarks[route->numActive++] = best;
+    }
+    packRouteMarks(graph, route);
+}
+
+// adds the landmark with the best bound for node if it beats the active set,
+// returns true when the active set changed
+bool updateLandmarks(Graph *graph, Route *route, int node)
+{
+    if (route->numActive >= ALT_MAX_ACTIVE_LANDMARKS || route->numActive >= graph->m)
+        return false;
+
+    int activeBound = estimateALT(graph, route->destination, node,
+                                  route->activeMarks, route->numActive);
+    int best = -1;
+    int bestBound = activeBound;
+    for (int i = 0; i < graph->m; i++)
+    {
+        int bound = landmarkBound(graph, i, route->destination, node);
+        if (bound > bestBound)
+        {
+            best = i;
+            bestBound = bound;
+        }
+    }
+
+    // ignore landmarks that improve the bound by less than 1%
+    if (best < 0 || bestBound - activeBound <= activeBound / 100)
+        return false;
+
+    route->activeMarks[route->numActive++] = best;
+    packRouteMarks(graph, route);
+    return true;
+}
+
+// the estimates of queued nodes were made with the old active set,
+// recompute them and restore the heap order
+void refreshEstimates(Graph *graph, Route *route, SearchContext *search)
+{
+    Heap *heap = search->heap;
+    for (int i = 0; i < heap->length; i++)
+    {
+        int v = heap->nodes[i];
+        search->estimate[v] = estimateRoute(graph, route, v);
+        search->key[v] = search->dist[v] + search->estimate[v];
+    }
+
+    for (int i = heap->length / 2 - 1; i >= 0; i--)
+    {
+        heapFix(heap, i);
+    }
+}
+
+// uses Djikstra or ALT (A*, Landmarks, Triangle inequality)
+// to find the shortest path
+// to a destination, all other nodes or the closest gas stations/chargers
+// modes --- 0: djikstra, 2: fuel 4: chargers, 9: ALT, 12: A*
+// route->destination should be < 0 when checking all nodes (stopEarly = false)
+void djikstra(Graph *graph, SearchContext *search, Route *route,
+              bool stopEarly, char mode, int stations[], int stationsN)
+{
+    float startTime = (float)clock() / CLOCKS_PER_SEC;
+
+    char *name = mode == MODE_ALT ? "ALT" : (mode == MODE_ASTAR ? "A*" : "Djikstra");
+    if (!quiet)
+        printf("\n%s from: %s (%i) to: %s (%i)\n", name,
+               graph->name[route->start],
+               graph->nr[route->start],
+               route->destination < 0 ? "ALL" : graph->name[route->destination],
+               route->destination < 0 ? -1 : graph->nr[route->destination]);
+
+    if (mode == MODE_ALT)
+        searchUseBinaryHeap(search);
+    Heap *heap = search->heap;
+    searchClear(search);
+    searchSource(search, route->start, 0);
+    int checked = 0;
+    int landmarkUpdates = 0;
+
+    if (mode == MODE_ALT)
+        chooseLandmarks(graph, route, route->start);
+    if (mode == MODE_ALT && !quiet)
+    {
+        printf("active landmarks:");
+        for (int a = 0; a < route->numActive; a++)
+        {
+            printf(" %i", route->activeMarks[a]);
+        }
+        printf(" of %i\n", graph->m);
+    }
+    int stationsFound = 0;
+
+    int prevQueueWeight = 0;
+    int queueWeightSmallerCount = 0;
+
+    while (!heapEmpty(heap))
+    {
+        int nodeNr = heapGetMin(heap);
+        search->settled[nodeNr] = true;
+        search->numSettled++;
+        checked++;
+
+        if (search->key[nodeNr] < prevQueueWeight)
+        {
+            if (validate)
+            {
+                int previous = search->previous[nodeNr];
+                printf("queue weight:%i < prevQueueWeight:%i heapLength:%i\n",
+                       search->key[nodeNr], prevQueueWeight, heap->length);
+                printf("node: %.7f %.7f\n", graph->lat[nodeNr], graph->lon[nodeNr]);
+                printf("prev: %.7f %.7f\n", graph->lat[previous], graph->lon[previous]);
+            }
+            queueWeightSmallerCount++;
+        }
+        prevQueueWeight = search->key[nodeNr];
+
+        if (mode == MODE_ALT && checked % ALT_RECHECK_INTERVAL == 0 &&
+            updateLandmarks(graph, route, nodeNr))
+        {
+            refreshEstimates(graph, route, search);
+            landmarkUpdates++;
+        }
+
+        // handle gas stations/chargers
+        if ((mode == MODE_FUEL || mode == MODE_CHARGER) &&
+            graph->mode[nodeNr] == mode && stationsFound < stationsN)
+        {
+            stations[stationsFound++] = nodeNr;
+            if (stationsFound == stationsN)
+            {
+                if (!quiet)
+                    printf("found %i %s\n",
+                       stationsN, mode == MODE_FUEL ? "gas stations" : "chargers");
+                break;
+            }
+        }
+
+        // found destination
+        if (stopEarly && nodeNr == route->destination)
+        {
+            route->distance = search->dist[nodeNr];
+            findPath(search, route);
+            if (!quiet)
+            {
+                printf("distance: %i time: ", route->distance);
+                printDrivingTime(route->distance);
+                printf(" nodes: %i\n", route->numNodes);
+            }
+            break;
+        }
+
+        // check all neighbors and update distances
+        for (int e = graph->edgeStart[nodeNr]; e < graph->edgeStart[nodeNr + 1]; e++)
+        {
+            int neighbor = graph->edgeTo[e];
+            int newNeighborDist = search->dist[nodeNr] + graph->edgeWeight[e];
+            searchTouch(search, neighbor);
+            if (newNeighborDist >= search->dist[neighbor])
+                continue;
+            // only ALT can settle a node too early, the rounded landmark
+            // distances keep the estimates admissible but not consistent
+            search->settled[neighbor] = false;
+
+            int estimate = 0;
+            if (mode == MODE_ALT)
+            {
+                if (search->estimate[neighbor] == -infinity)
+                {
+                    search->estimate[neighbor] = estimateRoute(graph, route, neighbor);
+                    if (validate)
+                        validateEstimate(graph, route, neighbor, search->estimate[neighbor]);
+                }
+                estimate = search->estimate[neighbor];
+            }
+            else if (mode == MODE_ASTAR)
+            {
+                if (search->estimate[neighbor] == -infinity)
+                    search->estimate[neighbor] = estimateGeo(graph, route->destination, neighbor);
+                estimate = search->estimate[neighbor];
+            }
+
+            search->dist[neighbor] = newNeighborDist;
+            search->key[neighbor] = newNeighborDist + estimate;
+            search->previous[neighbor] = nodeNr;
+            heapDecreaseKey(heap, neighbor);
+        }
+    }
+
+    if (quiet)
+        return;
+
+    printf("queueWeightSmallerCount: %i\n", queueWeightSmallerCount);
+    if (mode == MODE_ALT)
+        printf("landmark updates: %i active: %i\n", landmarkUpdates, route->numActive);
+
+    float endTime = (float)clock() / CLOCKS_PER_SEC;
+    float timeElapsed = endTime - startTime;
+    printf("%s done in %.2fs, checked:%i\n", name, timeElapsed, checked);
+}
+
+// number of worker threads, DALT_THREADS overrides the number of cores
+int numThreads()
+{
+    char *env = getenv("DALT_THREADS");
+    if (env != NULL && atoi(env) > 0)
+        return atoi(env);
+
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return cores > 0 ? (int)cores : 1;
+}
+
+void searchReset(SearchContext *search, int start)
+{
+    searchClear(search);
+    searchSource(search, start, 0);
+}
+
+// returns the next node to settle without removing it, -1 when empty
+int searchPeek(SearchContext *search)
+{
+    return heapPeek(search->heap);
+}
+
+// settles the next node and relaxes its edges, returns it or -1 when done
+int searchStep(Graph *graph, SearchContext *search)
+{
+    int nodeNr = searchPeek(search);
+    if (nodeNr < 0)
+        return -1;
+
+    int *dist = search->dist;
+    heapGetMin(search->heap);
+    search->settled[nodeNr] = true;
+    if (search->order != NULL)
+        search->order[search->numSettled] = nodeNr;
+    search->numSettled++;
+
+    for (int e = graph->edgeStart[nodeNr]; e < graph->edgeStart[nodeNr + 1]; e++)
+    {
+        int neighbor = graph->edgeTo[e];
+        int newNeighborDist = dist[nodeNr] + graph->edgeWeight[e];
+        searchTouch(search, neighbor);
+        if (!search->settled[neighbor] && newNeighborDist < dist[neighbor])
+        {
+            dist[neighbor] = newNeighborDist;
+            search->key[neighbor] = newNeighborDist;
+            search->previous[neighbor] = nodeNr;
+            heapDecreaseKey(search->heap, neighbor);
+        }
+    }
+    return nodeNr;
+}
+
+// one-to-all Djikstra, read the result with searchDist
+void searchAll(Graph *graph, SearchContext *search, int start)
+{
+    searchReset(search, start);
+    while (searchStep(graph, search) >= 0)
+        ;
+}
+
+// route->path from the forward search tree up to meet and
+// the backward search tree (edges of graphRev) from meet to the destination
+void stitchPath(Route *route, SearchContext *forward, SearchContext *backward, int meet)
+{
+    int forwardNodes = 0;
+    for (int v = meet; v >= 0; v = forward->previous[v])
+    {
+        forwardNodes++;
+    }
+    int backwardNodes = 0;
+    for (int v = backward->previous[meet]; v >= 0; v = backward->previous[v])
+    {
+        backwardNodes++;
+    }
+
+    route->numNodes = forwardNodes + backwardNodes;
+    route->path = calloc(route->numNodes, sizeof(int));
+
+    int i = forwardNodes - 1;
+    for (int v = meet; v >= 0; v = forward->previous[v])
+    {
+        route->path[i--] = v;
+    }
+    i = forwardNodes;
+    for (int v = backward->previous[meet]; v >= 0; v = backward->previous[v])
+    {
+        route->path[i++] = v;
+    }
+}
+
+// bidirectional Djikstra, forward from route->start on graph and backward
+// from route->destination on graphRev, always expanding the side with the
+// smaller queue minimum, done when the two minimums add up to the best
+// distance found through a node reached from both sides
+void bidirectional(Graph *graph, Graph *graphRev, Route *route)
+{
+    float startTime = (float)clock() / CLOCKS_PER_SEC;
+
+    printf("\nBidirectional Djikstra from: %s (%i) to: %s (%i)\n",
+           graph->name[route->start], graph->nr[route->start],
+           graph->name[route->destination], graph->nr[route->destination]);
+
+    SearchContext *forward = initSearch(graph);
+    SearchContext *backward = initSearch(graph);
+    searchReset(forward, route->start);
+    searchReset(backward, route->destination);
+
+    int best = infinity;
+    int meet = -1;
+
+    while (true)
+    {
+        int topForward = searchPeek(forward);
+        int topBackward = searchPeek(backward);
+        if (topForward < 0 || topBackward < 0)
+            break;
+
+        int forwardMin = forward->dist[topForward];
+        int backwardMin = backward->dist[topBackward];
+        if (forwardMin + backwardMin >= best)
+            break;
+
+        bool stepForward = forwardMin <= backwardMin;
+        SearchContext *search = stepForward ? forward : backward;
+        SearchContext *other = stepForward ? backward : forward;
+        int nodeNr = searchStep(stepForward ? graph : graphRev, search);
+
+        // the settled node and its neighbors can join the two searches
+        Graph *g = stepForward ? graph : graphRev;
+        for (int e = g->edgeStart[nodeNr] - 1; e < g->edgeStart[nodeNr + 1]; e++)
+        {
+            int v = e < g->edgeStart[nodeNr] ? nodeNr : g->edgeTo[e];
+            int total = searchDist(search, v) + searchDist(other, v);
+            if (searchDist(search, v) < infinity && searchDist(other, v) < infinity &&
+                total < best)
+            {
+                best = total;
+                meet = v;
+            }
+        }
+    }
+
+    if (meet >= 0)
+    {
+        route->distance = best;
+        printf("distance: %i time: ", best);
+        printDrivingTime(best);
+        printf(" ");
+        stitchPath(route, forward, backward, meet);
+        printf("nodes: %i\n", route->numNodes);
+    }
+
+    float endTime = (float)clock() / CLOCKS_PER_SEC;
+    float timeElapsed = endTime - startTime;
+    printf("Bidirectional done in %.2fs, checked:%i (forward:%i backward:%i)\n",
+           timeElapsed, forward->numSettled + backward->numSettled,
+           forward->numSettled, backward->numSettled);
+
+    freeSearch(forward);
+    freeSearch(backward);
+}
+
+// average potential of bidirectional ALT, (d(v, goal) - d(start, v)) / 2,
+// kept doubled so it stays an integer, the backward search uses -potential.
+// both directions cache it in the estimates of the forward context
+int altPotential(Graph *graph, Route *route, SearchContext *cache, int v)
+{
+    searchTouch(cache, v);
+    if (cache->estimate[v] == -infinity)
+        cache->estimate[v] = estimateRoute(graph, route, v) - estimateFromStart(graph, route, v);
+    return cache->estimate[v];
+}
+
+// like searchStep on the edges of g (graph or its reverse), but the queue is
+// ordered by key = 2 * dist + sign * potential from graph's landmarks
+int altStep(Graph *graph, Graph *g, Route *route, SearchContext *search,
+            SearchContext *cache, int sign)
+{
+    int nodeNr = searchPeek(search);
+    if (nodeNr < 0)
+        return -1;
+
+    int *dist = search->dist;
+    heapGetMin(search->heap);
+    search->settled[nodeNr] = true;
+    search->numSettled++;
+
+    for (int e = g->edgeStart[nodeNr]; e < g->edgeStart[nodeNr + 1]; e++)
+    {
+        int neighbor = g->edgeTo[e];
+        int newNeighborDist = dist[nodeNr] + g->edgeWeight[e];
+        searchTouch(search, neighbor);
+        if (newNeighborDist < dist[neighbor])
+        {
+            search->settled[neighbor] = false;
+            dist[neighbor] = newNeighborDist;
+            search->key[neighbor] = 2 * newNeighborDist +
+                                    sign * altPotential(graph, route, cache, neighbor);
+            search->previous[neighbor] = nodeNr;
+            heapDecreaseKey(search->heap, neighbor);
+        }
+    }
+    return nodeNr;
+}
+
+// bidirectional ALT with average potentials, both searches use the same
+// potential (negated backwards). with exact landmark distances it is
+// consistent and the Djikstra stopping rule holds: done when
+// topForward + topBackward >= 2 * best. the rounded distances make each
+// landmark bound up to 2 * (markScale - 1) smaller than the exact one, so
+// nodes can be reopened and the rule needs that much slack on both ends
+void bidirectionalALT(Graph *graph, Graph *graphRev, Route *route)
+{
+    float startTime = (float)clock() / CLOCKS_PER_SEC;
+
+    printf("\nBidirectional ALT from: %s (%i) to: %s (%i)\n",
+           graph->name[route->start], graph->nr[route->start],
+           graph->name[route->destination], graph->nr[route->destination]);
+
+    // the potential must not change during the search, so no landmark updates
+    chooseLandmarks(graph, route, route->start);
+    printf("active landmarks:");
+    for (int a = 0; a < route->numActive; a++)
+    {
+        printf(" %i", route->activeMarks[a]);
+    }
+    printf(" of %i\n", graph->m);
+
+    SearchContext *forward = initSearch(graph);
+    SearchContext *backward = initSearch(graph);
+    searchUseBinaryHeap(forward);
+    searchUseBinaryHeap(backward);
+    searchClear(forward);
+    searchClear(backward);
+    searchSource(forward, route->start,
+                 altPotential(graph, route, forward, route->start));
+    searchSource(backward, route->destination,
+                 -altPotential(graph, route, forward, route->destination));
+
+    int best = infinity;
+    int meet = -1;
+    long slack = 4L * (graph->markScale - 1);
+
+    while (true)
+    {
+        int topForward = searchPeek(forward);
+        int topBackward = searchPeek(backward);
+        if (topForward < 0 || topBackward < 0)
+            break;
+
+        int forwardMin = forward->key[topForward];
+        int backwardMin = backward->key[topBackward];
+        if (best < infinity && (long)forwardMin + backwardMin >= 2L * best + slack)
+            break;
+
+        bool stepForward = forwardMin <= backwardMin;
+        SearchContext *search = stepForward ? forward : backward;
+        SearchContext *other = stepForward ? backward : forward;
+        Graph *g = stepForward ? graph : graphRev;
+        int nodeNr = altStep(graph, g, route, search, forward, stepForward ? 1 : -1);
+
+        for (int e = g->edgeStart[nodeNr] - 1; e < g->edgeStart[nodeNr + 1]; e++)
+        {
+            int v = e < g->edgeStart[nodeNr] ? nodeNr : g->edgeTo[e];
+            int total = searchDist(search, v) + searchDist(other, v);
+            if (searchDist(search, v) < infinity && searchDist(other, v) < infinity &&
+                total < best)
+            {
+                best = total;
+                meet = v;
+            }
+        }
+    }
+
+    if (meet >= 0)
+    {
+        route->distance = best;
+        printf("distance: %i time: ", best);
+        printDrivingTime(best);
+        printf(" ");
+        stitchPath(route, forward, backward, meet);
+        printf("nodes: %i\n", route->numNodes);
+    }
+
+    float endTime = (float)clock() / CLOCKS_PER_SEC;
+    float timeElapsed = endTime - startTime;
+    printf("Bidirectional ALT done in %.2fs, checked:%i (forward:%i backward:%i)\n",
+           timeElapsed, forward->numSettled + backward->numSettled,
+           forward->numSettled, backward->numSettled);
+
+    freeSearch(forward);
+    freeSearch(backward);
+}
+
+// 2*m independent searches shared by the preprocessing threads,
+// job j is landmark j / 2, forward on graph for even j and reverse for odd,
+// when the landmark selection already filled fromMarks only odd jobs run
+typedef struct LandmarkJobsStruct
+{
+    Graph *graph;
+    Graph *graphRev;
+    int *landmarks;
+    int m;
+    int *fromMarks;
+    int *toMarks;
+    bool forwardDone;
+    int numJobs;
+    int next;
+    int done;
+    pthread_mutex_t lock;
+} LandmarkJobs;
+
+void *landmarkWorker(void *arg)
+{
+    LandmarkJobs *jobs = arg;
+    SearchContext *search = initSearch(jobs->graph);
+
+    while (true)
+    {
+        pthread_mutex_lock(&jobs->lock);
+        int job = jobs->next < jobs->numJobs ? jobs->next++ : -1;
+        pthread_mutex_unlock(&jobs->lock);
+        if (job < 0)
+            break;
+        if (jobs->forwardDone)
+            job = 2 * job + 1;
+
+        int i = job / 2;
+        bool reverse = job % 2 == 1;
+        searchAll(reverse ? jobs->graphRev : jobs->graph, search, jobs->landmarks[i]);
+
+        // each job owns column i of its table, no locking needed
+        int *marks = reverse ? jobs->toMarks : jobs->fromMarks;
+        for (int j = 0; j < jobs->graph->n; j++)
+        {
+            *(marks + j * jobs->m + i) = searchDist(search, j);
+        }
+
+        pthread_mutex_lock(&jobs->lock);
+        jobs->done++;
+        printf("\r\33[2K%i/%i landmark searches done", jobs->done, jobs->numJobs);
+        fflush(stdout);
+        pthread_mutex_unlock(&jobs->lock);
+    }
+
+    freeSearch(search);
+    return NULL;
+}
+
+// largest finite value of dist, -1 if nothing else is reachable
+int farthestNode(Graph *graph, int dist[])
+{
+    int farthest = -1;
+    for (int i = 0; i < graph->n; i++)
+    {
+        if (dist[i] < infinity && (farthest < 0 || dist[i] > dist[farthest]))
+            farthest = i;
+    }
+    return farthest;
+}
+
+// same for the distances of the last search
+int farthestReached(Graph *graph, SearchContext *search)
+{
+    int farthest = -1;
+    for (int i = 0; i < graph->n; i++)
+    {
+        int dist = searchDist(search, i);
+        if (dist < infinity && (farthest < 0 || dist > search->dist[farthest]))
+            farthest = i;
+    }
+    return farthest;
+}
+
+void copyMarks(Graph *graph, int marks[], int m, int i, SearchContext *search)
+{
+    for (int j = 0; j < graph->n; j++)
+    {
+        *(marks + j * m + i) = searchDist(search, j);
+    }
+}
+
+// farthest: each landmark is the node farthest from the ones already
+// chosen, the forward search from every landmark becomes its fromMarks column
+void selectFarthest(Graph *graph, SearchContext *search, int fromMarks[],
+                    int landmarks[], int m, int start)
+{
+    int *minDist = malloc(graph->n * sizeof(int));
+    for (int j = 0; j < graph->n; j++)
+    {
+        minDist[j] = infinity;
+    }
+
+    searchAll(graph, search, start);
+    int landmark = farthestReached(graph, search);
+
+    for (int i = 0; i < m; i++)
+    {
+        landmarks[i] = landmark;
+        searchAll(graph, search, landmark);
+        copyMarks(graph, fromMarks, m, i, search);
+
+        for (int j = 0; j < graph->n; j++)
+        {
+            if (searchDist(search, j) < minDist[j])
+                minDist[j] = search->dist[j];
+        }
+        landmark = farthestNode(graph, minDist);
+    }
+    free(minDist);
+}
+
+// avoid (Goldberg & Werneck): grow a shortest path tree from a random root,
+// weigh each node by how bad the current landmarks bound its distance from
+// the root, and take the leaf of the heaviest subtree without a landmark
+void selectAvoid(Graph *graph, SearchContext *search, int fromMarks[],
+                 int landmarks[], int m, unsigned seed)
+{
+    long *size = malloc(graph->n * sizeof(long));
+    int *bestChild = malloc(graph->n * sizeof(int));
+    bool *isLandmark = calloc(graph->n, sizeof(bool));
+    bool *hasLandmark = malloc(graph->n * sizeof(bool));
+    search->order = malloc(graph->n * sizeof(int));
+
+    for (int i = 0; i < m; i++)
+    {
+        int root = rand_r(&seed) % graph->n;
+        searchAll(graph, search, root);
+
+        for (int s = 0; s < search->numSettled; s++)
+        {
+            int v = search->order[s];
+            int bound = 0;
+            for (int l = 0; l < i; l++)
+            {
+                int behind = *(fromMarks + v * m + l) - *(fromMarks + root * m + l);
+                if (behind > bound && *(fromMarks + v * m + l) < infinity)
+                    bound = behind;
+            }
+            size[v] = search->dist[v] > bound ? search->dist[v] - bound : 0;
+            bestChild[v] = -1;
+            hasLandmark[v] = isLandmark[v];
+        }
+
+        // children are settled after their parents, so walk the order backwards,
+        // subtrees that contain a landmark count as size 0
+        for (int s = search->numSettled - 1; s > 0; s--)
+        {
+            int v = search->order[s];
+            int parent = search->previous[v];
+            if (hasLandmark[v])
+            {
+                hasLandmark[parent] = true;
+                continue;
+            }
+
+            size[parent] += size[v];
+            if (bestChild[parent] < 0 || size[v] > size[bestChild[parent]])
+                bestChild[parent] = v;
+        }
+
+        int leaf = root;
+        while (bestChild[leaf] >= 0)
+        {
+            leaf = bestChild[leaf];
+        }
+        if (isLandmark[leaf])
+            leaf = farthestReached(graph, search);
+
+        landmarks[i] = leaf;
+        isLandmark[leaf] = true;
+        searchAll(graph, search, leaf);
+        copyMarks(graph, fromMarks, m, i, search);
+    }
+
+    free(size);
+    free(bestChild);
+    free(isLandmark);
+    free(hasLandmark);
+    free(search->order);
+    search->order = NULL;
+}
+
+// node closest to the average coordinate, used when no center is given
+int centerNode(Graph *graph)
+{
+    double lat = 0, lon = 0;
+    for (int i = 0; i < graph->n; i++)
+    {
+        lat += graph->lat[i];
+        lon += graph->lon[i];
+    }
+    lat /= graph->n;
+    lon /= graph->n;
+
+    int center = 0;
+    double best = -1;
+    for (int i = 0; i < graph->n; i++)
+    {
+        double dLat = graph->lat[i] - lat;
+        double dLon = graph->lon[i] - lon;
+        double d = dLat * dLat + dLon * dLon;
+        if (best < 0 || d < best)
+        {
+            best = d;
+            center = i;
+        }
+    }
+    return center;
+}
+
+// planar: split the map into m equal sectors around center and take the
+// node in each sector that is farthest from center by travel time
+void selectPlanar(Graph *graph, SearchContext *search, int landmarks[], int m, int center)
+{
+    searchAll(graph, search, center);
+    double centerLat = graph->lat[center];
+    double centerLon = graph->lon[center];
+    double lonScale = cos(centerLat * M_PI / 180);
+
+    for (int i = 0; i < m; i++)
+    {
+        landmarks[i] = -1;
+    }
+
+    for (int j = 0; j < graph->n; j++)
+    {
+        if (searchDist(search, j) >= infinity)
+            continue;
+
+        double angle = atan2(graph->lat[j] - centerLat,
+                             (graph->lon[j] - centerLon) * lonScale);
+        int sector = (int)((angle + M_PI) / (2 * M_PI) * m) % m;
+        if (landmarks[sector] < 0 || search->dist[j] > search->dist[landmarks[sector]])
+            landmarks[sector] = j;
+    }
+
+    // empty sectors get the farthest node that isn't a landmark yet
+    for (int i = 0; i < m; i++)
+    {
+        if (landmarks[i] >= 0)
+            continue;
+
+        int farthest = -1;
+        for (int j = 0; j < graph->n; j++)
+        {
+            bool used = false;
+            for (int l = 0; l < m; l++)
+            {
+                used = used || landmarks[l] == j;
+            }
+            if (!used && searchDist(search, j) < infinity &&
+                (farthest < 0 || search->dist[j] > search->dist[farthest]))
+                farthest = j;
+        }
+        landmarks[i] = farthest;
+    }
+}
+
+// average estimateALT / true distance over random reachable pairs,
+// 1.0 would mean the landmarks give exact distances
+void reportTightness(Graph *graph, SearchContext *search)
+{
+    unsigned seed = 2;
+    double tightness = 0;
+    int pairs = 0;
+
+    for (int s = 0; s < TIGHTNESS_SOURCES; s++)
+    {
+        int source = rand_r(&seed) % graph->n;
+        searchAll(graph, search, source);
+
+        for (int t = 0; t < TIGHTNESS_TARGETS; t++)
+        {
+            int target = rand_r(&seed) % graph->n;
+            int dist = searchDist(search, target);
+            if (dist >= infinity || dist == 0)
+                continue;
+
+            tightness += (double)estimateALT(graph, target, source, NULL, 0) / dist;
+            pairs++;
+        }
+    }
+
+    if (pairs > 0)
+        printf("average heuristic tightness %.3f over %i queries\n", tightness / pairs, pairs);
+}
+
+// one-to-all searches from the same random sources with each queue,
+// the distance sums must match
+void benchQueues(char nodeFile[], char edgeFile[], char poiFile[], int searches)
+{
+    Graph *graph = loadGraph(nodeFile, edgeFile, poiFile);
+    int *sources = malloc(searches * sizeof(int));
+    srand(1);
+    for (int i = 0; i < searches; i++)
+    {
+        sources[i] = rand() % graph->n;
+    }
+
+    bool oldQueue = radixQueue;
+    long sums[2] = {0, 0};
+    for (int q = 0; q < 2; q++)
+    {
+        radixQueue = q == 1;
+        SearchContext *search = initSearch(graph);
+        double startTime = wallTime();
+        for (int i = 0; i < searches; i++)
+        {
+            searchAll(graph, search, sources[i]);
+            for (int v = 0; v < graph->n; v++)
+            {
+                if (searchDist(search, v) < infinity)
+                    sums[q] += search->dist[v];
+            }
+        }
+        double timeElapsed = wallTime() - startTime;
+        printf("%s heap: %i one-to-all searches in %.2fs (%.1fms each)\n",
+               radixQueue ? "radix" : "binary", searches, timeElapsed,
+               timeElapsed * 1000 / searches);
+        freeSearch(search);
+    }
+    radixQueue = oldQueue;
+
+    if (sums[0] != sums[1])
+        printf("distance sums differ: %li %li\n", sums[0], sums[1]);
+    free(sources);
+    exit(0);
+}
+
+// position of x, y in [0, 2^16) on the hilbert curve, nodes close on the
+// curve are close on the map so their rows end up close in memory
+long hilbertKey(unsigned x, unsigned y)
+{
+    long key = 0;
+    for (unsigned side = 1u << 15; side > 0; side /= 2)
+    {
+        unsigned rx = (x & side) > 0;
+        unsigned ry = (y & side) > 0;
+        key += (long)side * side * ((3 * rx) ^ ry);
+        // rotate the quadrant so the curve stays continuous
+        if (ry == 0)
+        {
+            if (rx == 1)
+            {
+                x = side - 1 - x;
+                y = side - 1 - y;
+            }
+            unsigned swap = x;
+            x = y;
+            y = swap;
+        }
+    }
+    return key;
+}
+
+long *hilbertKeys; // for compareHilbert, qsort has no context argument
+
+int compareHilbert(const void *a, const void *b)
+{
+    long ka = hilbertKeys[*(const int *)a];
+    long kb = hilbertKeys[*(const int *)b];
+    return ka < kb ? -1 : ka > kb;
+}
+
+// order[i] is the node that gets index i
+int *hilbertOrder(Graph *graph)
+{
+    double minLat = graph->lat[0], maxLat = minLat;
+    double minLon = graph->lon[0], maxLon = minLon;
+    for (int i = 1; i < graph->n; i++)
+    {
+        minLat = fmin(minLat, graph->lat[i]);
+        maxLat = fmax(maxLat, graph->lat[i]);
+        minLon = fmin(minLon, graph->lon[i]);
+        maxLon = fmax(maxLon, graph->lon[i]);
+    }
+
+    double scale = 65535 / fmax(fmax(maxLat - minLat, maxLon - minLon), 1e-9);
+    hilbertKeys = malloc(graph->n * sizeof(long));
+    int *order = malloc(graph->n * sizeof(int));
+    for (int i = 0; i < graph->n; i++)
+    {
+        unsigned x = (unsigned)((graph->lon[i] - minLon) * scale);
+        unsigned y = (unsigned)((graph->lat[i] - minLat) * scale);
+        hilbertKeys[i] = hilbertKey(x, y);
+        order[i] = i;
+    }
+    qsort(order, graph->n, sizeof(int), compareHilbert);
+    free(hilbertKeys);
+    hilbertKeys = NULL;
+    return order;
+}
+
+// depth first preorder along the edges, unreached nodes start a new tree
+int *dfsOrder(Graph *graph)
+{
+    int *order = malloc(graph->n * sizeof(int));
+    int *stack = malloc((graph->k + graph->n) * sizeof(int));
+    bool *visited = calloc(graph->n, sizeof(bool));
+    int numOrdered = 0;
+
+    for (int root = 0; root < graph->n; root++)
+    {
+        int top = 0;
+        stack[top++] = root;
+        while (top > 0)
+        {
+            int v = stack[--top];
+            if (visited[v])
+                continue;
+            visited[v] = true;
+            order[numOrdered++] = v;
+            // pushed in reverse so the first edge is visited first
+            for (int e = graph->edgeStart[v + 1] - 1; e >= graph->edgeStart[v]; e--)
+            {
+                if (!visited[graph->edgeTo[e]])
+                    stack[top++] = graph->edgeTo[e];
+            }
+        }
+    }
+
+    free(visited);
+    free(stack);
+    return order;
+}
+
+// copy of graph where node order[i] becomes index i, node nr keeps the id
+Graph *permuteGraph(Graph *graph, int order[])
+{
+    Graph *permuted = calloc(1, sizeof(Graph));
+    permuted->n = graph->n;
+    permuted->k = graph->k;
+    permuted->numNames = graph->numNames;
+    permuted->geoScale = graph->geoScale;
+    permuted->mode = malloc(graph->n * sizeof(char));
+    permuted->nr = malloc(graph->n * sizeof(int));
+    permuted->name = malloc(graph->n * sizeof(char *));
+    permuted->lat = malloc(graph->n * sizeof(double));
+    permuted->lon = malloc(graph->n * sizeof(double));
+    permuted->edgeStart = malloc((graph->n + 1) * sizeof(int));
+    permuted->edgeTo = malloc(graph->k * sizeof(int));
+    permuted->edgeWeight = malloc(graph->k * sizeof(int));
+    permuted->internalId = malloc(graph->n * sizeof(int));
+
+    int *index = malloc(graph->n * sizeof(int));
+    for (int i = 0; i < graph->n; i++)
+    {
+        index[order[i]] = i;
+    }
+
+    int e = 0;
+    for (int i = 0; i < graph->n; i++)
+    {
+        int v = order[i];
+        permuted->mode[i] = graph->mode[v];
+        permuted->nr[i] = graph->nr[v];
+        permuted->name[i] = graph->name[v];
+        permuted->lat[i] = graph->lat[v];
+        permuted->lon[i] = graph->lon[v];
+        permuted->internalId[graph->nr[v]] = i;
+        permuted->edgeStart[i] = e;
+        for (int f = graph->edgeStart[v]; f < graph->edgeStart[v + 1]; f++, e++)
+        {
+            permuted->edgeTo[e] = index[graph->edgeTo[f]];
+            permuted->edgeWeight[e] = graph->edgeWeight[f];
+        }
+    }
+    permuted->edgeStart[graph->n] = e;
+
+    free(index);
+    return permuted;
+}
+
+// the same random queries on both graphs, ids mapped through node nr,
+// returns the average query time in ms
+double benchOrder(Graph *graph, int from[], int to[], int queries, long *sum)
+{
+    SearchContext *search = initSearch(graph);
+    *sum = 0;
+    double startTime = wallTime();
+    for (int q = 0; q < queries; q++)
+    {
+        Route *route = initRoute(graphNode(graph, from[q]), graphNode(graph, to[q]));
+        djikstra(graph, search, route, true, MODE_DJIKSTRA, NULL, 0);
+        if (route->distance < infinity)
+            *sum += route->distance;
+        freeRoute(route);
+    }
+    double timeElapsed = wallTime() - startTime;
+    freeSearch(search);
+    return timeElapsed * 1000 / queries;
+}
+
+// writes a snapshot with the nodes in hilbert or dfs order, queries on it
+// touch fewer cache lines, then compares query times against the input order
+void runReorder(char nodeFile[], char edgeFile[], char poiFile[], char outFile[],
+                bool dfs, int queries)
+{
+    Graph *graph = loadGraph(nodeFile, edgeFile, poiFile);
+    double startTime = wallTime();
+    int *order = dfs ? dfsOrder(graph) : hilbertOrder(graph);
+    Graph *reordered = permuteGraph(graph, order);
+    printf("%s order in %.2fs\n", dfs ? "dfs" : "hilbert", wallTime() - startTime);
+    free(order);
+    writeSnapshot(reordered, outFile);
+
+    int *from = malloc(queries * sizeof(int));
+    int *to = malloc(queries * sizeof(int));
+    srand(1);
+    for (int q = 0; q < queries; q++)
+    {
+        from[q] = graph->nr[rand() % graph->n];
+        to[q] = graph->nr[rand() % graph->n];
+    }
+
+    quiet = true;
+    long sums[2];
+    double before = benchOrder(graph, from, to, queries, &sums[0]);
+    double after = benchOrder(reordered, from, to, queries, &sums[1]);
+    printf("%i queries: %.2fms each in input order, %.2fms each in %s order (%.2fx)\n",
+           queries, before, after, dfs ? "dfs" : "hilbert", before / after);
+    if (sums[0] != sums[1])
+        printf("distance sums differ: %li %li\n", sums[0], sums[1]);
+
+    free(from);
+    free(to);
+    exit(0);
+}
+
+// hash of the node ids and edges in index order, a landmark file only
+// fits the graph (and node order) it was computed on
+uint64_t graphChecksum(Graph *graph)
+{
+    uint64_t hash = 1469598103934665603ull;
+    int k = graph->edgeStart[graph->n];
+    const int *arrays[] = {graph->nr, graph->edgeStart, graph->edgeTo, graph->edgeWeight};
+    const int lengths[] = {graph->n, graph->n + 1, k, k};
+
+    for (int a = 0; a < 4; a++)
+    {
+        for (int i = 0; i < lengths[a]; i++)
+        {
+            hash = (hash ^ (uint32_t)arrays[a][i]) * 1099511628211ull;
+        }
+    }
+    return hash;
+}
+
+// stores the tables as multiples of the smallest scale that fits the
+// longest distance in 16 bits, rounded down, see markLow and markHigh
+void quantizeMarks(Graph *graph, int fromMarks[], int toMarks[], int m)
+{
+    long cells = (long)m * graph->n;
+    int longest = 0;
+    for (long i = 0; i < cells; i++)
+    {
+        if (fromMarks[i] < infinity && fromMarks[i] > longest)
+            longest = fromMarks[i];
+        if (toMarks[i] < infinity && toMarks[i] > longest)
+            longest = toMarks[i];
+    }
+
+    graph->m = m;
+    graph->markScale = longest / MARK_UNREACHABLE + 1;
+    graph->fromMarks = malloc(cells * sizeof(uint16_t));
+    graph->toMarks = malloc(cells * sizeof(uint16_t));
+    for (long i = 0; i < cells; i++)
+    {
+        graph->fromMarks[i] = fromMarks[i] < infinity ? fromMarks[i] / graph->markScale : MARK_UNREACHABLE;
+        graph->toMarks[i] = toMarks[i] < infinity ? toMarks[i] / graph->markScale : MARK_UNREACHABLE;
+    }
+}
+
+void writeLandmarks(Graph *graph, int landmarks[], char outFile[])
+{
+    FILE *fpOut = fopen(outFile, "wb");
+    if (fpOut == NULL)
+    {
+        perror("Error while opening outfile");
+        exit(1);
+    }
+
+    int ids[graph->m];
+    for (int i = 0; i < graph->m; i++)
+    {
+        ids[i] = graph->nr[landmarks[i]];
+    }
+
+    LandmarkHeader header = {0};
+    memcpy(header.magic, LANDMARKS_MAGIC, sizeof(header.magic));
+    header.version = LANDMARKS_VERSION;
+    header.n = graph->n;
+    header.m = graph->m;
+    header.markScale = graph->markScale;
+    header.checksum = graphChecksum(graph);
+    fwrite(&header, sizeof(header), 1, fpOut);
+
+    long cells = (long)graph->m * graph->n;
+    header.landmarkOffset = snapshotSection(fpOut, ids, sizeof(int), graph->m);
+    header.fromOffset = snapshotSection(fpOut, graph->fromMarks, sizeof(uint16_t), cells);
+    header.toOffset = snapshotSection(fpOut, graph->toMarks, sizeof(uint16_t), cells);
+
+    // rewrite the header now that the section offsets are known
+    fseek(fpOut, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, fpOut);
+    fclose(fpOut);
+}
+
+// preProcess(norNode, norEdge, norPoi, norPre, landmarks, m, LANDMARKS_GIVEN, -1);
+// for the other strategies landmarks is filled with the m chosen nodes,
+// center is the start of farthest and the center of planar (-1 picks one)
+void preProcess(char nodeFile[], char edgeFile[], char poiFile[],
+                char outFile[], int landmarks[], int m, int strategy, int center)
+{
+    printf("preprocessing %i landmarks\n", m);
+    double startTime = wallTime();
+
+    Graph *graph = loadGraph(nodeFile, edgeFile, poiFile);
+    Graph *graphRev = reverseGraph(graph);
+
+    int *fromMarks = calloc(m * graph->n, sizeof(int));
+    int *toMarks = calloc(m * graph->n, sizeof(int));
+
+    SearchContext *search = initSearch(graph);
+    unsigned seed = 1;
+    if (center < 0)
+        center = strategy == LANDMARKS_PLANAR ? centerNode(graph) : rand_r(&seed) % graph->n;
+
+    if (strategy == LANDMARKS_FARTHEST)
+        selectFarthest(graph, search, fromMarks, landmarks, m, center);
+    else if (strategy == LANDMARKS_AVOID)
+        selectAvoid(graph, search, fromMarks, landmarks, m, seed);
+    else if (strategy == LANDMARKS_PLANAR)
+        selectPlanar(graph, search, landmarks, m, center);
+
+    for (int i = 0; i < m; i++)
+    {
+        printf("landmark %s (%i)\n", graph->name[landmarks[i]], graph->nr[landmarks[i]]);
+    }
+
+    // farthest and avoid already ran the forward searches while choosing
+    bool forwardDone = strategy == LANDMARKS_FARTHEST || strategy == LANDMARKS_AVOID;
+    int numJobs = forwardDone ? m : 2 * m;
+    LandmarkJobs jobs = {0};
+    jobs.graph = graph;
+    jobs.graphRev = graphRev;
+    jobs.landmarks = landmarks;
+    jobs.m = m;
+    jobs.fromMarks = fromMarks;
+    jobs.toMarks = toMarks;
+    jobs.forwardDone = forwardDone;
+    jobs.numJobs = numJobs;
+    pthread_mutex_init(&jobs.lock, NULL);
+
+    int threads = numThreads();
+    if (threads > numJobs)
+        threads = numJobs;
+    printf("running %i searches on %i threads\n", numJobs, threads);
+
+    pthread_t workers[threads];
+    for (int t = 0; t < threads; t++)
+    {
+        pthread_create(&workers[t], NULL, landmarkWorker, &jobs);
+    }
+    for (int t = 0; t < threads; t++)
+    {
+        pthread_join(workers[t], NULL);
+    }
+    pthread_mutex_destroy(&jobs.lock);
+    printf("\n");
+
+    // the tightness report already sees the quantized bounds
+    quantizeMarks(graph, fromMarks, toMarks, m);
+    free(fromMarks);
+    free(toMarks);
+    reportTightness(graph, search);
+    freeSearch(search);
+    writeLandmarks(graph, landmarks, outFile);
+
+    double timeElapsed = wallTime() - startTime;
+    printf("preprocessed %i landmarks for %i nodes in %.2fs, %i per step\n",
+           m, graph->n, timeElapsed, graph->markScale);
+    exit(0);
+}
+
+// version 1 files are m, m landmark ids and the n * m int tables with rows
+// by node id, they are converted to the quantized tables in memory
+void loadLandmarksV1(Graph *graph, FILE *fp)
+{
+    int m = 0;
+    fread(&m, sizeof(int), 1, fp);
+    if (m < 1 || m > LANDMARKS_MAX)
+    {
+        fprintf(stderr, "unsupported landmark file with %i landmarks\n", m);
+        exit(1);
+    }
+    int *landmarks = calloc(m, sizeof(int));
+    fread(landmarks, sizeof(int), m, fp);
+    int *tables[2];
+    for (int t = 0; t < 2; t++)
+    {
+        int *rows = malloc((long)m * graph->n * sizeof(int));
+        fread(rows, sizeof(int), (long)m * graph->n, fp);
+        tables[t] = malloc((long)m * graph->n * sizeof(int));
+        for (int i = 0; i < graph->n; i++)
+        {
+            memcpy(tables[t] + (long)i * m, rows + (long)graph->nr[i] * m, m * sizeof(int));
+        }
+        free(rows);
+    }
+
+    quantizeMarks(graph, tables[0], tables[1], m);
+    free(tables[0]);
+    free(tables[1]);
+    free(landmarks);
+    printf("converted version 1 landmark file, run pre again to map it directly\n");
+}
+
+// maps a landmark file written by writeLandmarks, pages of the tables are
+// only read when a query touches their nodes
+void loadPreProcess(Graph *graph, char preFile[])
+{
+    printf("loading preprocessed landmarks from %s\n", preFile);
+    double startTime = wallTime();
+
+    int fd = open(preFile, O_RDONLY);
+    if (fd < 0)
+    {
+        perror("Error while opening file");
+        exit(1);
+    }
+
+    struct stat st;
+    LandmarkHeader header = {0};
+    if (fstat(fd, &st) < 0 || read(fd, &header, sizeof(header)) < 8)
+    {
+        fprintf(stderr, "%s is not a landmark file\n", preFile);
+        exit(1);
+    }
+
+    if (memcmp(header.magic, LANDMARKS_MAGIC, sizeof(header.magic)) != 0)
+    {
+        FILE *fp = fdopen(fd, "rb");
+        fseek(fp, 0, SEEK_SET);
+        loadLandmarksV1(graph, fp);
+        fclose(fp);
+    }
+    else
+    {
+        long cells = (long)header.m * header.n;
+        if (header.version != LANDMARKS_VERSION || header.m < 1 || header.m > LANDMARKS_MAX ||
+            header.toOffset + cells * (long)sizeof(uint16_t) > st.st_size)
+        {
+            fprintf(stderr, "%s: unsupported landmark file (version %i, expected %i)\n",
+                    preFile, header.version, LANDMARKS_VERSION);
+            exit(1);
+        }
+        if (header.n != graph->n || header.checksum != graphChecksum(graph))
+        {
+            fprintf(stderr, "%s was made for a different graph or node order\n", preFile);
+            exit(1);
+        }
+
+        char *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED)
+        {
+            perror("Error while mapping file");
+            exit(1);
+        }
+        // queries jump between far apart rows, read ahead would be wasted
+        madvise(data, st.st_size, MADV_RANDOM);
+
+        graph->m = header.m;
+        graph->markScale = header.markScale;
+        graph->fromMarks = (uint16_t *)(data + header.fromOffset);
+        graph->toMarks = (uint16_t *)(data + header.toOffset);
+    }
+
+    printf("loaded %i landmarks for %i nodes in %.2fs\n",
+           graph->m, graph->n, wallTime() - startTime);
+}
+
+void chListAdd(CHList *list, int to, int weight, int middle)
+{
+    if (list->length == list->capacity)
+    {
+        list->capacity = list->capacity ? list->capacity * 2 : 4;
+        list->arcs = realloc(list->arcs, list->capacity * sizeof(CHArc));
+    }
+    list->arcs[list->length++] = (CHArc){to, weight, middle};
+}
+
+void chListRemove(CHList *list, int to)
+{
+    for (int i = 0; i < list->length; i++)
+    {
+        if (list->arcs[i].to == to)
+        {
+            list->arcs[i--] = list->arcs[--list->length];
+        }
+    }
+}
+
+// keeps only the shortest arc between two nodes, returns false if the
+// existing arc was already as short
+bool chAddArc(CHList out[], CHList in[], int from, int to, int weight, int middle)
+{
+    for (int i = 0; i < out[from].length; i++)
+    {
+        CHArc *arc = &out[from].arcs[i];
+        if (arc->to != to)
+            continue;
+        if (arc->weight <= weight)
+            return false;
+
+        arc->weight = weight;
+        arc->middle = middle;
+        for (int j = 0; j < in[to].length; j++)
+        {
+            if (in[to].arcs[j].to == from)
+            {
+                in[to].arcs[j].weight = weight;
+                in[to].arcs[j].middle = middle;
+            }
+        }
+        return true;
+    }
+
+    chListAdd(&out[from], to, weight, middle);
+    chListAdd(&in[to], from, weight, middle);
+    return true;
+}
+
+// state of the local witness searches, only touched nodes are reset
+typedef struct WitnessStruct
+{
+    int *dist;
+    bool *settled;
+    int *touched;
+    int numTouched;
+    int *target; // target[x] == round when x is a target of this round
+    int round;
+    Heap *heap;
+} Witness;
+
+// Djikstra from source among the uncontracted nodes, skipping via,
+// stops at limit, once all targets are settled or after
+// CH_WITNESS_SETTLE_LIMIT settled nodes
+void witnessSearch(CHList out[], Witness *witness, int source, int via, int limit, int targets)
+{
+    for (int i = 0; i < witness->numTouched; i++)
+    {
+        witness->dist[witness->touched[i]] = infinity;
+        witness->settled[witness->touched[i]] = false;
+    }
+    witness->numTouched = 0;
+    heapClear(witness->heap);
+
+    witness->dist[source] = 0;
+    witness->touched[witness->numTouched++] = source;
+    heapInsert(witness->heap, source);
+
+    int settledCount = 0;
+    while (witness->heap->length > 0 && settledCount < CH_WITNESS_SETTLE_LIMIT)
+    {
+        int u = heapGetMin(witness->heap);
+        if (witness->dist[u] > limit)
+            break;
+        witness->settled[u] = true;
+        settledCount++;
+        if (witness->target[u] == witness->round && --targets == 0)
+            break;
+
+        for (int i = 0; i < out[u].length; i++)
+        {
+            int v = out[u].arcs[i].to;
+            int newDist = witness->dist[u] + out[u].arcs[i].weight;
+            if (v == via || witness->settled[v] || newDist >= witness->dist[v])
+                continue;
+
+            if (witness->dist[v] == infinity)
+                witness->touched[witness->numTouched++] = v;
+            witness->dist[v] = newDist;
+            heapDecreaseKey(witness->heap, v);
+        }
+    }
+}
+
+// shortcuts needed to contract v, added to the lists unless simulate is set
+int chContract(CHList out[], CHList in[], Witness *witness, int v, bool simulate)
+{
+    int shortcuts = 0;
+    witness->round++;
+    for (int j = 0; j < out[v].length; j++)
+    {
+        witness->target[out[v].arcs[j].to] = witness->round;
+    }
+
+    for (int i = 0; i < in[v].length; i++)
+    {
+        int u = in[v].arcs[i].to;
+        int toV = in[v].arcs[i].weight;
+
+        int limit = 0;
+        int targets = 0;
+        for (int j = 0; j < out[v].length; j++)
+        {
+            if (out[v].arcs[j].to == u)
+                continue;
+            targets++;
+            if (toV + out[v].arcs[j].weight > limit)
+                limit = toV + out[v].arcs[j].weight;
+        }
+        // u is not a target of its own search
+        int uTarget = witness->target[u];
+        witness->target[u] = -1;
+        witnessSearch(out, witness, u, v, limit, targets);
+        witness->target[u] = uTarget;
+
+        for (int j = 0; j < out[v].length; j++)
+        {
+            int x = out[v].arcs[j].to;
+            int weight = toV + out[v].arcs[j].weight;
+            if (x == u || witness->dist[x] <= weight)
+                continue;
+
+            if (simulate)
+                shortcuts++;
+            else if (chAddArc(out, in, u, x, weight, v))
+                shortcuts++;
+        }
+    }
+    return shortcuts;
+}
+
+// edge difference plus the number of contracted neighbors,
+// the latter keeps the contraction spread out over the graph
+int chPriority(CHList out[], CHList in[], Witness *witness, int v, int deleted[])
+{
+    int shortcuts = chContract(out, in, witness, v, true);
+    return shortcuts - out[v].length - in[v].length + deleted[v];
+}
+
+void writeCH(CH *ch, uint64_t checksum, int upEdges, int downEdges, char outFile[])
+{
+    FILE *fpOut = fopen(outFile, "wb");
+    if (fpOut == NULL)
+    {
+        perror("Error while opening outfile");
+        exit(1);
+    }
+
+    CHHeader header = {0};
+    memcpy(header.magic, CH_MAGIC, sizeof(header.magic));
+    header.version = CH_VERSION;
+    header.n = ch->n;
+    header.checksum = checksum;
+    header.upEdges = upEdges;
+    header.downEdges = downEdges;
+    fwrite(&header, sizeof(header), 1, fpOut);
+
+    header.rankOffset = snapshotSection(fpOut, ch->rank, sizeof(int), ch->n);
+    header.upStartOffset = snapshotSection(fpOut, ch->upStart, sizeof(int), ch->n + 1);
+    header.upToOffset = snapshotSection(fpOut, ch->upTo, sizeof(int), upEdges);
+    header.upWeightOffset = snapshotSection(fpOut, ch->upWeight, sizeof(int), upEdges);
+    header.upMiddleOffset = snapshotSection(fpOut, ch->upMiddle, sizeof(int), upEdges);
+    header.downStartOffset = snapshotSection(fpOut, ch->downStart, sizeof(int), ch->n + 1);
+    header.downToOffset = snapshotSection(fpOut, ch->downTo, sizeof(int), downEdges);
+    header.downWeightOffset = snapshotSection(fpOut, ch->downWeight, sizeof(int), downEdges);
+    header.downMiddleOffset = snapshotSection(fpOut, ch->downMiddle, sizeof(int), downEdges);
+
+    fseek(fpOut, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, fpOut);
+    fclose(fpOut);
+}
+
+// flattens the arcs of every node (all to higher ranked nodes once the node
+// is contracted) into CSR arrays
+void chFlatten(CHList lists[], int n, int **start, int **to, int **weight,
+               int **middle, int *count)
+{
+    *start = calloc(n + 1, sizeof(int));
+    for (int v = 0; v < n; v++)
+    {
+        (*start)[v + 1] = (*start)[v] + lists[v].length;
+    }
+    *count = (*start)[n];
+    *to = malloc(*count * sizeof(int));
+    *weight = malloc(*count * sizeof(int));
+    *middle = malloc(*count * sizeof(int));
+
+    for (int v = 0; v < n; v++)
+    {
+        for (int i = 0; i < lists[v].length; i++)
+        {
+            int e = (*start)[v] + i;
+            (*to)[e] = lists[v].arcs[i].to;
+            (*weight)[e] = lists[v].arcs[i].weight;
+            (*middle)[e] = lists[v].arcs[i].middle;
+        }
+    }
+}
+
+// contracts the nodes in order of chPriority with lazy updates: the popped
+// node's priority is recomputed and it goes back in the queue if it is no
+// longer the smallest, neighbors are updated after each contraction
+void chPreProcess(char nodeFile[], char edgeFile[], char poiFile[], char outFile[])
+{
+    double startTime = wallTime();
+    Graph *graph = loadGraph(nodeFile, edgeFile, poiFile);
+    int n = graph->n;
+
+    CHList *out = calloc(n, sizeof(CHList));
+    CHList *in = calloc(n, sizeof(CHList));
+    for (int u = 0; u < n; u++)
+    {
+        for (int e = graph->edgeStart[u]; e < graph->edgeStart[u + 1]; e++)
+        {
+            if (graph->edgeTo[e] != u)
+                chAddArc(out, in, u, graph->edgeTo[e], graph->edgeWeight[e], -1);
+        }
+    }
+
+    // the remaining arcs of a contracted node all lead to higher ranked nodes
+    CHList *up = calloc(n, sizeof(CHList));
+    CHList *down = calloc(n, sizeof(CHList));
+
+    Witness witness = {0};
+    witness.dist = malloc(n * sizeof(int));
+    witness.settled = calloc(n, sizeof(bool));
+    witness.touched = malloc(n * sizeof(int));
+    witness.target = calloc(n, sizeof(int));
+    witness.heap = initHeap(n, witness.dist);
+    for (int i = 0; i < n; i++)
+    {
+        witness.dist[i] = infinity;
+    }
+
+    int *priority = malloc(n * sizeof(int));
+    int *deleted = calloc(n, sizeof(int));
+    // neighbors of the contracted node, each once even when it is both an out
+    // and an in neighbor, stamp[u] is the order of the last contraction next to u
+    int *neighbors = malloc(n * sizeof(int));
+    int *stamp = malloc(n * sizeof(int));
+    for (int i = 0; i < n; i++)
+    {
+        stamp[i] = -1;
+    }
+    CH ch = {0};
+    ch.n = n;
+    ch.rank = malloc(n * sizeof(int));
+
+    Heap *queue = initHeap(n, priority);
+    for (int v = 0; v < n; v++)
+    {
+        priority[v] = chPriority(out, in, &witness, v, deleted);
+        heapInsert(queue, v);
+    }
+    printf("initial priorities in %.2fs\n", wallTime() - startTime);
+
+    int order = 0;
+    long shortcuts = 0;
+    while (queue->length > 0)
+    {
+        int v = heapGetMin(queue);
+        priority[v] = chPriority(out, in, &witness, v, deleted);
+        if (queue->length > 0 && priority[v] > heapWeight(queue, 0))
+        {
+            heapInsert(queue, v);
+            continue;
+        }
+
+        shortcuts += chContract(out, in, &witness, v, false);
+        ch.rank[v] = order++;
+
+        for (int i = 0; i < out[v].length; i++)
+        {
+            chListAdd(&up[v], out[v].arcs[i].to, out[v].arcs[i].weight, out[v].arcs[i].middle);
+        }
+        for (int i = 0; i < in[v].length; i++)
+        {
+            chListAdd(&down[v], in[v].arcs[i].to, in[v].arcs[i].weight, in[v].arcs[i].middle);
+        }
+
+        // v is gone from the remaining graph, update its neighbors
+        int numNeighbors = 0;
+        for (int pass = 0; pass < 2; pass++)
+        {
+            CHList *list = pass == 0 ? &out[v] : &in[v];
+            for (int i = 0; i < list->length; i++)
+            {
+                int u = list->arcs[i].to;
+                chListRemove(pass == 0 ? &in[u] : &out[u], v);
+                if (stamp[u] != order)
+                {
+                    stamp[u] = order;
+                    neighbors[numNeighbors++] = u;
+                    deleted[u]++;
+                }
+            }
+        }
+        for (int i = 0; i < numNeighbors; i++)
+        {
+            int u = neighbors[i];
+            int newPriority = chPriority(out, in, &witness, u, deleted);
+            if (newPriority != priority[u])
+            {
+                priority[u] = newPriority;
+                heapUpdate(queue, u);
+            }
+        }
+        free(out[v].arcs);
+        free(in[v].arcs);
+        out[v] = (CHList){0};
+        in[v] = (CHList){0};
+
+        if (order % 10000 == 0)
+        {
+            printf("\r\33[2Kcontracted %i/%i nodes, %li shortcuts", order, n, shortcuts);
+            fflush(stdout);
+        }
+    }
+    printf("\r\33[2Kcontracted %i nodes, %li shortcuts\n", order, shortcuts);
+
+    int upEdges, downEdges;
+    chFlatten(up, n, &ch.upStart, &ch.upTo, &ch.upWeight, &ch.upMiddle, &upEdges);
+    chFlatten(down, n, &ch.downStart, &ch.downTo, &ch.downWeight, &ch.downMiddle, &downEdges);
+    writeCH(&ch, graphChecksum(graph), upEdges, downEdges, outFile);
+    free(neighbors);
+    free(stamp);
+
+    printf("contraction hierarchy with %i up and %i down edges written to %s in %.2fs\n",
+           upEdges, downEdges, outFile, wallTime() - startTime);
+    exit(0);
+}
+
+CH *loadCH(char chFile[], Graph *graph)
+{
+    int fd = open(chFile, O_RDONLY);
+    if (fd < 0)
+    {
+        perror("Error while opening file");
+        exit(1);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(CHHeader))
+    {
+        fprintf(stderr, "%s is not a contraction hierarchy\n", chFile);
+        exit(1);
+    }
+
+    char *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        perror("Error while mapping file");
+        exit(1);
+    }
+
+    CHHeader *header = (CHHeader *)data;
+    if (memcmp(header->magic, CH_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != CH_VERSION)
+    {
+        fprintf(stderr, "%s: unsupported contraction hierarchy (version %i, expected %i)\n",
+                chFile, header->version, CH_VERSION);
+        exit(1);
+    }
+    if (header->n != graph->n || header->checksum != graphChecksum(graph))
+    {
+        fprintf(stderr, "%s was made for a different graph or node order\n", chFile);
+        exit(1);
+    }
+
+    int64_t offsets[] = {header->rankOffset, header->upStartOffset, header->upToOffset,
+                         header->upWeightOffset, header->upMiddleOffset,
+                         header->downStartOffset, header->downToOffset,
+                         header->downWeightOffset, header->downMiddleOffset};
+    long counts[] = {header->n, header->n + 1L, header->upEdges, header->upEdges,
+                     header->upEdges, header->n + 1L, header->downEdges,
+                     header->downEdges, header->downEdges};
+    for (int i = 0; i < 9; i++)
+    {
+        if (offsets[i] < (int64_t)sizeof(CHHeader) || counts[i] < 0 ||
+            offsets[i] + counts[i] * (long)sizeof(int) > st.st_size)
+        {
+            fprintf(stderr, "%s is truncated or corrupt\n", chFile);
+            exit(1);
+        }
+    }
+
+    CH *ch = calloc(1, sizeof(CH));
+    ch->n = header->n;
+    ch->rank = (int *)(data + header->rankOffset);
+    ch->upStart = (int *)(data + header->upStartOffset);
+    ch->upTo = (int *)(data + header->upToOffset);
+    ch->upWeight = (int *)(data + header->upWeightOffset);
+    ch->upMiddle = (int *)(data + header->upMiddleOffset);
+    ch->downStart = (int *)(data + header->downStartOffset);
+    ch->downTo = (int *)(data + header->downToOffset);
+    ch->downWeight = (int *)(data + header->downWeightOffset);
+    ch->downMiddle = (int *)(data + header->downMiddleOffset);
+
+    printf("mapped contraction hierarchy with %i up and %i down edges\n",
+           header->upEdges, header->downEdges);
+    return ch;
+}
+
+// appends the original nodes of the edge from -> to after from,
+// a shortcut via middle is the down edge middle <- from and the up edge middle -> to
+void chUnpack(CH *ch, int from, int to, int middle, int path[], int *length)
+{
+    if (middle < 0)
+    {
+        path[(*length)++] = to;
+        return;
+    }
+
+    for (int e = ch->downStart[middle]; e < ch->downStart[middle + 1]; e++)
+    {
+        if (ch->downTo[e] == from)
+        {
+            chUnpack(ch, from, middle, ch->downMiddle[e], path, length);
+            break;
+        }
+    }
+    for (int e = ch->upStart[middle]; e < ch->upStart[middle + 1]; e++)
+    {
+        if (ch->upTo[e] == to)
+        {
+            chUnpack(ch, middle, to, ch->upMiddle[e], path, length);
+            break;
+        }
+    }
+}
+
+// one direction of the CH query, previousEdge is the up or down edge used to
+// reach a node so shortcuts can be unpacked afterwards
+typedef struct CHSearchStruct
+{
+    SearchContext *search;
+    int *previousEdge;
+} CHSearch;
+
+void chSearchStep(CH *ch, CHSearch *chSearch, bool forward)
+{
+    SearchContext *search = chSearch->search;
+    int u = searchPeek(search);
+    heapGetMin(search->heap);
+    search->settled[u] = true;
+    search->numSettled++;
+
+    int *start = forward ? ch->upStart : ch->downStart;
+    int *to = forward ? ch->upTo : ch->downTo;
+    int *weight = forward ? ch->upWeight : ch->downWeight;
+    for (int e = start[u]; e < start[u + 1]; e++)
+    {
+        int v = to[e];
+        int newDist = search->dist[u] + weight[e];
+        searchTouch(search, v);
+        if (search->settled[v] || newDist >= search->dist[v])
+            continue;
+
+        search->dist[v] = newDist;
+        search->key[v] = newDist;
+        search->previous[v] = u;
+        chSearch->previousEdge[v] = e;
+        heapDecreaseKey(search->heap, v);
+    }
+}
+
+// bidirectional search that only follows edges to higher ranked nodes,
+// each side stops when its queue minimum can't improve the best meeting node
+void chQuery(Graph *graph, CH *ch, Route *route)
+{
+    double startTime = wallTime();
+
+    printf("\nCH from: %s (%i) to: %s (%i)\n",
+           graph->name[route->start], graph->nr[route->start],
+           graph->name[route->destination], graph->nr[route->destination]);
+
+    CHSearch sides[2];
+    for (int d = 0; d < 2; d++)
+    {
+        sides[d].search = initSearch(graph);
+        sides[d].previousEdge = malloc(graph->n * sizeof(int));
+        searchReset(sides[d].search, d == 0 ? route->start : route->destination);
+    }
+    double setupTime = wallTime() - startTime;
+    startTime = wallTime();
+
+    int best = infinity;
+    int meet = -1;
+    bool forward = true;
+    while (true)
+    {
+        int topForward = searchPeek(sides[0].search);
+        int topBackward = searchPeek(sides[1].search);
+        bool forwardDone = topForward < 0 || sides[0].search->dist[topForward] >= best;
+        bool backwardDone = topBackward < 0 || sides[1].search->dist[topBackward] >= best;
+        if (forwardDone && backwardDone)
+            break;
+
+        // alternate while both sides are active
+        if (forwardDone || backwardDone)
+            forward = backwardDone;
+        CHSearch *side = &sides[forward ? 0 : 1];
+        SearchContext *other = sides[forward ? 1 : 0].search;
+        int u = forward ? topForward : topBackward;
+
+        chSearchStep(ch, side, forward);
+        if (searchDist(other, u) < infinity && side->search->dist[u] + other->dist[u] < best)
+        {
+            best = side->search->dist[u] + other->dist[u];
+            meet = u;
+        }
+        forward = !forward;
+    }
+    double queryTime = wallTime() - startTime;
+
+    if (meet >= 0)
+    {
+        route->distance = best;
+        printf("distance: %i time: ", best);
+        printDrivingTime(best);
+        printf(" ");
+
+        // up edges from start to meet, then down edges from meet to destination
+        int *upPath = malloc(graph->n * sizeof(int));
+        int upLength = 0;
+        for (int v = meet; v != route->start; v = sides[0].search->previous[v])
+        {
+            upPath[upLength++] = sides[0].previousEdge[v];
+        }
+
+        int *path = malloc(graph->n * sizeof(int));
+        int length = 0;
+        path[length++] = route->start;
+        for (int i = upLength - 1; i >= 0; i--)
+        {
+            int e = upPath[i];
+            chUnpack(ch, path[length - 1], ch->upTo[e], ch->upMiddle[e], path, &length);
+        }
+        for (int v = meet; v != route->destination; v = sides[1].search->previous[v])
+        {
+            int e = sides[1].previousEdge[v];
+            int next = sides[1].search->previous[v];
+            chUnpack(ch, v, next, ch->downMiddle[e], path, &length);
+        }
+
+        route->numNodes = length;
+        route->path = calloc(length, sizeof(int));
+        memcpy(route->path, path, length * sizeof(int));
+        printf("nodes: %i\n", route->numNodes);
+        free(upPath);
+        free(path);
+    }
+
+    printf("CH done in %.3fms (setup %.3fms), checked:%i (forward:%i backward:%i)\n",
+           queryTime * 1000, setupTime * 1000,
+           sides[0].search->numSettled + sides[1].search->numSettled,
+           sides[0].search->numSettled, sides[1].search->numSettled);
+
+    for (int d = 0; d < 2; d++)
+    {
+        freeSearch(sides[d].search);
+        free(sides[d].previousEdge);
+    }
+}
+
+void runCH(char nodeFile[], char edgeFile[], char poiFile[], char chFile[], char outFile[],
+           int from, int to)
+{
+    printf("nodes:%s edges:%s pois:%s\n", nodeFile, edgeFile, poiFile);
+    Graph *graph = loadGraph(nodeFile, edgeFile, poiFile);
+    CH *ch = loadCH(chFile, graph);
+    Route *route = initRoute(from, to);
+
+    chQuery(graph, ch, route);
+    writePath(graph, route, outFile);
+    exit(0);
+}
+
+// points as csv (<label>,node,latitude,longitude), a GeoJSON FeatureCollection
+// or an encoded polyline in the given order, labels[i] is the first column
+void writePoints(Graph *graph, int nodes[], int labels[], int n, char *label,
+                 int decimals, char outFile[])
+{
+    int format = outputFormat(outFile);
+    OutBuffer *out = openOutput(outFile);
+
+    if (format == OUTPUT_POLYLINE)
+    {
+        outPolyline(out, graph, nodes, NULL, n);
+        outChar(out, '\n');
+    }
+    else if (format == OUTPUT_GEOJSON)
+    {
+        outString(out, "{\"type\":\"FeatureCollection\",\"features\":[\n");
+        for (int i = 0; i < n; i++)
+        {
+            outString(out, i > 0 ? ",\n{\"type\":\"Feature\",\"geometry\":{\"type\":\"Point\","
+                                   "\"coordinates\":["
+                                 : "{\"type\":\"Feature\",\"geometry\":{\"type\":\"Point\","
+                                   "\"coordinates\":[");
+            outFixed(out, graph->lon[nodes[i]], decimals);
+            outChar(out, ',');
+            outFixed(out, graph->lat[nodes[i]], decimals);
+            outString(out, "]},\"properties\":{\"");
+            outString(out, label);
+            outString(out, "\":");
+            outInt(out, labels[i]);
+            outString(out, ",\"node\":");
+            outInt(out, graph->nr[nodes[i]]);
+            outString(out, "}}");
+        }
+        outString(out, "\n]}\n");
+    }
+    else
+    {
+        outString(out, label);
+        outString(out, ",node,latitude,longitude\n");
+        for (int i = 0; i < n; i++)
+        {
+            outInt(out, labels[i]);
+            outChar(out, ',');
+            outInt(out, graph->nr[nodes[i]]);
+            outChar(out, ',');
+            outFixed(out, graph->lat[nodes[i]], decimals);
+            outChar(out, ',');
+            outFixed(out, graph->lon[nodes[i]], decimals);
+            outChar(out, '\n');
+        }
+    }
+    closeOutput(out);
+}
+
+void writeStations(Graph *graph, char mode, int stations[], int n, char outFile[])
+{
+    int *modes = malloc(n * sizeof(int));
+    for (int i = 0; i < n; i++)
+    {
+        modes[i] = mode == MODE_FUEL || mode == MODE_CHARGER ? mode : 0;
+    }
+    writePoints(graph, stations, modes, n, "mode", 8, outFile);
+    free(modes);
+    printf("coordinates written to %s\n", outFile);
+}
+
+void findStations(Graph *graph, SearchContext *search, Route *route, char outFile[],
+                  char mode, int n)
+{
+    int stations[n];
+    for (int i = 0; i < n; i++)
+    {
+        stations[i] = 0;
+    }
+    djikstra(graph, search, route, false, mode, stations, n);
+    writeStations(graph, mode, stations, n, outFile);
+}
+
+void runFindStations(char nodeFile[], char edgeFile[], char poiFile[], char outFile[],
+                     char mode, int n, int node)
+{
+    printf("\n nodes:%s edges:%s pois:%s\n", nodeFile, edgeFile, poiFile);
+    Graph *graph = loadGraph(nodeFile, edgeFile, poiFile);
+    Route *route = initRoute(node, -1);
+
+    findStations(graph, initSearch(graph), route, outFile, mode, n);
+    exit(0);
+}
+
+// multi-source Djikstra on the reverse graph from every station of mode,
+// so search->dist is the time from each node to its nearest station, which
+// is found by following the search tree back to the source it grew from
+void nearestStations(Graph *graph, Graph *graphRev, SearchContext *search, char mode,
+                     int station[], int dist[])
+{
+    searchClear(search);
+    int sources = 0;
+    for (int v = 0; v < graph->n; v++)
+    {
+        if (graph->mode[v] == mode)
+        {
+            searchSource(search, v, 0);
+            sources++;
+        }
+    }
+
+    search->order = malloc(graph->n * sizeof(int));
+    while (searchStep(graphRev, search) >= 0)
+        ;
+
+    for (int v = 0; v < graph->n; v++)
+    {
+        station[v] = -1;
+        dist[v] = infinity;
+    }
+    // parents are settled before their children
+    for (int i = 0; i < search->numSettled; i++)
+    {
+        int v = search->order[i];
+        int parent = search->previous[v];
+        station[v] = parent < 0 ? v : station[parent];
+        dist[v] = search->dist[v];
+    }
+    free(search->order);
+    search->order = NULL;
+
+    printf("%i %s reach %i nodes\n",
+           sources, mode == MODE_FUEL ? "gas stations" : "chargers", search->numSettled);
+}
+
+void stationPreProcess(char nodeFile[], char edgeFile[], char poiFile[], char outFile[])
+{
+    double startTime = wallTime();
+    Graph *graph = loadGraph(nodeFile, edgeFile, poiFile);
+    Graph *graphRev = reverseGraph(graph);
+    SearchContext *search = initSearch(graph);
+
+    StationIndex index = {0};
+    index.n = graph->n;
+    index.fuelStation = malloc(graph->n * sizeof(int));
+    index.fuelDist = malloc(graph->n * sizeof(int));
+    index.chargerStation = malloc(graph->n * sizeof(int));
+    index.chargerDist = malloc(graph->n * sizeof(int));
+    nearestStations(graph, graphRev, search, MODE_FUEL, index.fuelStation, index.fuelDist);
+    nearestStations(graph, graphRev, search, MODE_CHARGER, index.chargerStation, index.chargerDist);
+
+    FILE *fpOut = fopen(outFile, "wb");
+    if (fpOut == NULL)
+    {
+        perror("Error while opening outfile");
+        exit(1);
+    }
+
+    StationIndexHeader header = {0};
+    memcpy(header.magic, STATIONS_MAGIC, sizeof(header.magic));
+    header.version = STATIONS_VERSION;
+    header.n = graph->n;
+    header.checksum = graphChecksum(graph);
+    fwrite(&header, sizeof(header), 1, fpOut);
+
+    header.fuelStationOffset = snapshotSection(fpOut, index.fuelStation, sizeof(int), graph->n);
+    header.fuelDistOffset = snapshotSection(fpOut, index.fuelDist, sizeof(int), graph->n);
+    header.chargerStationOffset = snapshotSection(fpOut, index.chargerStation, sizeof(int), graph->n);
+    header.chargerDistOffset = snapshotSection(fpOut, index.chargerDist, sizeof(int), graph->n);
+
+    fseek(fpOut, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, fpOut);
+    fclose(fpOut);
+
+    printf("station index written to %s in %.2fs\n", outFile, wallTime() - startTime);
+    exit(0);
+}
+
+StationIndex *loadStationIndex(char indexFile[], Graph *graph)
+{
+    int fd = open(indexFile, O_RDONLY);
+    if (fd < 0)
+    {
+        perror("Error while opening file");
+        exit(1);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(StationIndexHeader))
+    {
+        fprintf(stderr, "%s is not a station index\n", indexFile);
+        exit(1);
+    }
+
+    char *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        perror("Error while mapping file");
+        exit(1);
+    }
+
+    StationIndexHeader *header = (StationIndexHeader *)data;
+    if (memcmp(header->magic, STATIONS_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != STATIONS_VERSION)
+    {
+        fprintf(stderr, "%s: unsupported station index (version %i, expected %i)\n",
+                indexFile, header->version, STATIONS_VERSION);
+        exit(1);
+    }
+    if (header->n != graph->n || header->checksum != graphChecksum(graph))
+    {
+        fprintf(stderr, "%s was made for a different graph or node order\n", indexFile);
+        exit(1);
+    }
+
+    int64_t offsets[] = {header->fuelStationOffset, header->fuelDistOffset,
+                         header->chargerStationOffset, header->chargerDistOffset};
+    for (int i = 0; i < 4; i++)
+    {
+        if (offsets[i] < (int64_t)sizeof(StationIndexHeader) ||
+            offsets[i] + (long)header->n * (long)sizeof(int) > st.st_size)
+        {
+            fprintf(stderr, "%s is truncated or corrupt\n", indexFile);
+            exit(1);
+        }
+    }
+
+    StationIndex *index = calloc(1, sizeof(StationIndex));
+    index->n = header->n;
+    index->fuelStation = (int *)(data + header->fuelStationOffset);
+    index->fuelDist = (int *)(data + header->fuelDistOffset);
+    index->chargerStation = (int *)(data + header->chargerStationOffset);
+    index->chargerDist = (int *)(data + header->chargerDistOffset);
+    return index;
+}
+
+// O(1) nearest station, -1 if none can be reached from node
+int nearestStation(StationIndex *index, char mode, int node, int *dist)
+{
+    bool fuel = mode == MODE_FUEL;
+    *dist = fuel ? index->fuelDist[node] : index->chargerDist[node];
+    return fuel ? index->fuelStation[node] : index->chargerStation[node];
+}
+
+void runNearestStation(char nodeFile[], char edgeFile[], char poiFile[], char indexFile[],
+                       char mode, int node)
+{
+    Graph *graph = loadGraph(nodeFile, edgeFile, poiFile);
+    StationIndex *index = loadStationIndex(indexFile, graph);
+
+    int dist;
+    int station = nearestStation(index, mode, node, &dist);
+    if (station < 0)
+    {
+        printf("no %s reachable from %i\n", mode == MODE_FUEL ? "gas station" : "charger",
+               graph->nr[node]);
+        exit(0);
+    }
+
+    printf("nearest %s from %i: %i %s distance: %i time: ",
+           mode == MODE_FUEL ? "gas station" : "charger", graph->nr[node],
+           graph->nr[station],
+           graph->name[station] != NULL ? graph->name[station] : "", dist);
+    printDrivingTime(dist);
+    printf("\n");
+    exit(0);
+}
+
+// advances the backward search from the destination until node is settled,
+// gives up with infinity once the queue minimum reaches bound
+int detourDistToGoal(Graph *graphRev, SearchContext *backward, int node, long bound)
+{
+    while (!searchSettled(backward, node))
+    {
+        int top = searchPeek(backward);
+        if (top < 0 || backward->dist[top] >= bound)
+            return infinity;
+        searchStep(graphRev, backward);
+    }
+    return backward->dist[node];
+}
+
+// the n stations of mode with the smallest detour d(A,s) + d(s,B) - d(A,B).
+// the forward search from A is A* towards B, so a station settled later can't
+// have a smaller d(A,s) + d(s,B) than the current queue minimum, and the search
+// stops once that minimum minus d(A,B) can't beat the n-th best detour.
+// the rounded landmark distances can settle a station too early, it is then
+// reopened and settled again with a smaller detour.
+// d(s,B) comes from a backward search from B that only runs as far as needed
+int detourStations(Graph *graph, Graph *graphRev, Route *route, char mode, int n,
+                   int stations[], int detours[])
+{
+    bool hasLandmarks = graph->m > 0;
+    SearchContext *forward = initSearch(graph);
+    SearchContext *backward = initSearch(graph);
+    searchUseBinaryHeap(forward);
+
+    // d(A,B) first, ALT when landmarks are loaded
+    djikstra(graph, forward, route, true, hasLandmarks ? MODE_ALT : MODE_DJIKSTRA, NULL, 0);
+    int direct = route->distance;
+    if (direct >= infinity)
+    {
+        freeSearch(forward);
+        freeSearch(backward);
+        return 0;
+    }
+
+    // the potential must not change, so the landmarks are chosen once
+    if (hasLandmarks)
+        chooseLandmarks(graph, route, route->start);
+    searchClear(forward);
+    searchSource(forward, route->start, hasLandmarks ? estimateRoute(graph, route, route->start) : 0);
+    searchReset(backward, route->destination);
+
+    int found = 0;
+    while (true)
+    {
+        int nodeNr = searchPeek(forward);
+        long kth = found == n ? detours[n - 1] : infinity;
+        if (nodeNr < 0 || forward->key[nodeNr] - direct >= kth)
+            break;
+
+        heapGetMin(forward->heap);
+        forward->settled[nodeNr] = true;
+        forward->numSettled++;
+
+        if (graph->mode[nodeNr] == mode)
+        {
+            long bound = kth + direct - forward->dist[nodeNr];
+            int toGoal = detourDistToGoal(graphRev, backward, nodeNr, bound);
+            int detour = forward->dist[nodeNr] + toGoal - direct;
+            if (toGoal < infinity && detour < kth)
+            {
+                // a reopened station replaces its earlier entry
+                for (int j = 0; j < found; j++)
+                {
+                    if (stations[j] != nodeNr)
+                        continue;
+                    for (found--; j < found; j++)
+                    {
+                        detours[j] = detours[j + 1];
+                        stations[j] = stations[j + 1];
+                    }
+                }
+                // insertion into the sorted top n
+                int i = found < n ? found++ : n - 1;
+                while (i > 0 && detours[i - 1] > detour)
+                {
+                    detours[i] = detours[i - 1];
+                    stations[i] = stations[i - 1];
+                    i--;
+                }
+                detours[i] = detour;
+                stations[i] = nodeNr;
+            }
+        }
+
+        for (int e = graph->edgeStart[nodeNr]; e < graph->edgeStart[nodeNr + 1]; e++)
+        {
+            int neighbor = graph->edgeTo[e];
+            int newNeighborDist = forward->dist[nodeNr] + graph->edgeWeight[e];
+            searchTouch(forward, neighbor);
+            if (newNeighborDist >= forward->dist[neighbor])
+                continue;
+
+            forward->settled[neighbor] = false;
+            if (forward->estimate[neighbor] == -infinity)
+                forward->estimate[neighbor] = hasLandmarks ? estimateRoute(graph, route, neighbor) : 0;
+            forward->dist[neighbor] = newNeighborDist;
+            forward->key[neighbor] = newNeighborDist + forward->estimate[neighbor];
+            forward->previous[neighbor] = nodeNr;
+            heapDecreaseKey(forward->heap, neighbor);
+        }
+    }
+
+    printf("detour search checked:%i forward %i backward\n",
+           forward->numSettled, backward->numSettled);
+    freeSearch(forward);
+    freeSearch(backward);
+    return found;
+}
+
+void runDetourStations(char nodeFile[], char edgeFile[], char poiFile[], char preFile[],
+                       char outFile[], char mode, int n, int from, int to)
+{
+    Graph *graph = loadGraph(nodeFile, edgeFile, poiFile);
+    if (strcmp(preFile, "-") != 0)
+        loadPreProcess(graph, preFile);
+    Route *route = initRoute(from, to);
+
+    double startTime = wallTime();
+    int stations[n];
+    int detours[n];
+    int found = detourStations(graph, reverseGraph(graph), route, mode, n, stations, detours);
+    printf("detour search done in %.2fs\n", wallTime() - startTime);
+
+    if (route->distance >= infinity)
+    {
+        printf("%i can't be reached from %i\n", graph->nr[to], graph->nr[from]);
+        exit(0);
+    }
+    for (int i = 0; i < found; i++)
+    {
+        printf("%i: %i detour: %i time: ", i + 1, graph->nr[stations[i]], detours[i]);
+        printDrivingTime(detours[i]);
+        printf("\n");
+    }
+    writeStations(graph, mode, stations, found, outFile);
+    exit(0);
+}
+
+// settles every node within budget of start on g (the reverse graph for
+// "who can reach start"), the lazy reset keeps it inside that region
+void isochrone(Graph *g, SearchContext *search, int start, int budget)
+{
+    searchReset(search, start);
+    int top;
+    while ((top = searchPeek(search)) >= 0 && search->dist[top] <= budget)
+    {
+        searchStep(g, search);
+    }
+}
+
+// a reachable node is on the boundary when one of its edges leaves the region
+bool isBoundary(Graph *g, SearchContext *search, int v)
+{
+    for (int e = g->edgeStart[v]; e < g->edgeStart[v + 1]; e++)
+    {
+        if (!searchSettled(search, g->edgeTo[e]))
+            return true;
+    }
+    return false;
+}
+
+// settled (or only boundary) nodes in search order as csv, a GeoJSON
+// FeatureCollection or an encoded polyline depending on outputFormat
+void writeIsochrone(Graph *graph, Graph *g, SearchContext *search, char outFile[], bool boundary)
+{
+    int format = outputFormat(outFile);
+    int *nodes = malloc(search->numSettled * sizeof(int));
+    int written = 0;
+    for (int i = 0; i < search->numSettled; i++)
+    {
+        int v = search->order[i];
+        if (!boundary || isBoundary(g, search, v))
+            nodes[written++] = v;
+    }
+
+    OutBuffer *out = openOutput(outFile);
+    if (format == OUTPUT_POLYLINE)
+    {
+        outPolyline(out, graph, nodes, NULL, written);
+        outChar(out, '\n');
+    }
+    else if (format == OUTPUT_GEOJSON)
+    {
+        outString(out, "{\"type\":\"FeatureCollection\",\"features\":[\n");
+        for (int i = 0; i < written; i++)
+        {
+            int v = nodes[i];
+            outString(out, i > 0 ? ",\n{\"type\":\"Feature\",\"geometry\":{\"type\":\"Point\","
+                                   "\"coordinates\":["
+                                 : "{\"type\":\"Feature\",\"geometry\":{\"type\":\"Point\","
+                                   "\"coordinates\":[");
+            outFixed(out, graph->lon[v], 7);
+            outChar(out, ',');
+            outFixed(out, graph->lat[v], 7);
+            outString(out, "]},\"properties\":{\"node\":");
+            outInt(out, graph->nr[v]);
+            outString(out, ",\"time\":");
+            outInt(out, search->dist[v]);
+            outString(out, "}}");
+        }
+        outString(out, "\n]}\n");
+    }
+    else
+    {
+        outString(out, "node,latitude,longitude,time\n");
+        for (int i = 0; i < written; i++)
+        {
+            int v = nodes[i];
+            outInt(out, graph->nr[v]);
+            outChar(out, ',');
+            outFixed(out, graph->lat[v], 7);
+            outChar(out, ',');
+            outFixed(out, graph->lon[v], 7);
+            outChar(out, ',');
+            outInt(out, search->dist[v]);
+            outChar(out, '\n');
+        }
+    }
+    closeOutput(out);
+    free(nodes);
+    printf("%i %s written to %s\n", written, boundary ? "boundary nodes" : "nodes", outFile);
+}
+
+// options: reverse, boundary
+void runIsochrone(char nodeFile[], char edgeFile[], char poiFile[], char outFile[],
+                  int start, int seconds, char *options[], int numOptions)
+{
+    bool reverse = false, boundary = false;
+    for (int i = 0; i < numOptions; i++)
+    {
+        reverse = reverse || strcmp(options[i], "reverse") == 0;
+        boundary = boundary || strcmp(options[i], "boundary") == 0;
+    }
+
+    Graph *graph = loadGraph(nodeFile, edgeFile, poiFile);
+    Graph *g = reverse ? reverseGraph(graph) : graph;
+    SearchContext *search = initSearch(graph);
+    search->order = malloc(graph->n * sizeof(int));
+
+    double startTime = wallTime();
+    isochrone(g, search, start, seconds * 100);
+    printf("%i nodes %s %i within %i s in %.3fms\n", search->numSettled,
+           reverse ? "can reach" : "reachable from", graph->nr[start], seconds,
+           (wallTime() - startTime) * 1000);
+
+    writeIsochrone(graph, g, search, outFile, boundary);
+    exit(0);
+}
+
+// every 100th node index that was settled, nr is the index + 1
+void writeCheckedNodes(Graph *graph, SearchContext *search, char outFile[])
+{
+    int *nodes = malloc((graph->n / 100 + 1) * sizeof(int));
+    int *labels = malloc((graph->n / 100 + 1) * sizeof(int));
+    int n = 0;
+    for (int i = 0; i < graph->n; i += 100)
+    {
+        if (!searchSettled(search, i))
+            continue;
+        nodes[n] = i;
+        labels[n] = i + 1;
+        n++;
+    }
+    writePoints(graph, nodes, labels, n, "nr", 7, outFile);
+    free(nodes);
+    free(labels);
+    printf("checked coordinates written to %s\n", outFile);
+}
+
+void shortestPath(char nodeFile[], char edgeFile[], char poiFile[], char preFile[], char outFile[],
+                  char mode, int from, int to)
+{
+    printf("nodes:%s edges:%s pois:%s\n", nodeFile, edgeFile, poiFile);
+    Graph *graph = loadGraph(nodeFile, edgeFile, poiFile);
+    Route *route = initRoute(from, to);
+
+    if (preFile != NULL)
+        loadPreProcess(graph, preFile);
+
+    if (mode == MODE_BIDI)
+        bidirectional(graph, reverseGraph(graph), route);
+    else if (mode == MODE_BIDI_ALT)
+        bidirectionalALT(graph, reverseGraph(graph), route);
+    else
+        djikstra(graph, initSearch(graph), route, true, mode, NULL, 0);
+    if (!(route->destination < 0))
+    {
+        writePath(graph, route, outFile);
+    }
+    exit(0);
+}
+
+// the same random queries with Djikstra, A* and, with a landmark file, ALT,
+// reports the average number of settled nodes and time per query of each
+void runCompare(char nodeFile[], char edgeFile[], char poiFile[], char preFile[], int queries)
+{
+    Graph *graph = loadGraph(nodeFile, edgeFile, poiFile);
+    if (strcmp(preFile, "-") != 0)
+        loadPreProcess(graph, preFile);
+    // geoScale is centiseconds per meter
+    printf("A* assumes at most %.0f km/h as the crow flies\n", 360 / graph->geoScale);
+
+    char modes[] = {MODE_DJIKSTRA, MODE_ASTAR, MODE_ALT};
+    char *names[] = {"djik", "astar", "alt"};
+    int numModes = graph->m > 0 ? 3 : 2;
+    long checked[3] = {0, 0, 0};
+    long sums[3] = {0, 0, 0};
+    double seconds[3] = {0, 0, 0};
+
+    SearchContext *search = initSearch(graph);
+    srand(1);
+    quiet = true;
+    for (int q = 0; q < queries; q++)
+    {
+        int from = rand() % graph->n;
+        int to = rand() % graph->n;
+        for (int k = 0; k < numModes; k++)
+        {
+            Route *route = initRoute(from, to);
+            double startTime = wallTime();
+            djikstra(graph, search, route, true, modes[k], NULL, 0);
+            seconds[k] += wallTime() - startTime;
+            checked[k] += search->numSettled;
+            if (route->distance < infinity)
+                sums[k] += route->distance;
+            freeRoute(route);
+        }
+    }
+
+    for (int k = 0; k < numModes; k++)
+    {
+        printf("%-5s %9.0f checked (%5.1f%% of djik) %8.2fms per query\n", names[k],
+               (double)checked[k] / queries, 100.0 * checked[k] / checked[0],
+               seconds[k] * 1000 / queries);
+        if (sums[k] != sums[0])
+            printf("%s distances differ from djik: %li %li\n", names[k], sums[k], sums[0]);
+    }
+    freeSearch(search);
+    exit(0);
+}
+
+// query server, the graph and landmarks are loaded once and every worker
+// thread has its own SearchContext, clients[t] is the connection worker t
+// is serving (-1 when idle) so stopServer can end it
+typedef struct ServerStruct
+{
+    Graph *graph;
+    int listenFd;
+    int numWorkers;
+    int numStarted;
+    int *clients;
+    bool stopping;
+    pthread_mutex_t lock;
+} Server;
+
+// set by SIGINT and SIGTERM while serving a socket
+volatile sig_atomic_t stopSignal = 0;
+
+void onStopSignal(int signal)
+{
+    (void)signal;
+    stopSignal = 1;
+}
+
+// one query per line: djik|alt|astar <from> <to> [path|polyline], where the nodes
+// are ids or lat,lon snapped to the nearest node, answered with
+// "ok <distance> <h:mm:ss> <nodes> <ms>" and "path <node>..." or
+// "polyline <encoded>" of the route simplified to simplifyTolerance when asked,
+// "none" when the destination is unreachable or "error <message>",
+// returns true when the client sent quit, false at the end of input
+bool serveQueries(Server *server, SearchContext *search, FILE *in, FILE *out)
+{
+    Graph *graph = server->graph;
+    OutBuffer *buffer = initOutput(out);
+    char line[256];
+    bool quit = false;
+
+    while (fgets(line, sizeof(line), in))
+    {
+        int length = strlen(line);
+        if (length == sizeof(line) - 1 && line[length - 1] != '\n')
+        {
+            int c;
+            while ((c = fgetc(in)) != EOF && c != '\n')
+                ;
+            fprintf(out, "error query longer than %i characters\n", (int)sizeof(line) - 2);
+            fflush(out);
+            continue;
         }
 
-        // found destination
-        if (stopEarly && node->nr == route->destination)
+        char algorithm[8] = {0};
+        char option[16] = {0};
+        char fromArg[64] = {0};
+        char toArg[64] = {0};
+        int fields = sscanf(line, "%7s %63s %63s %15s", algorithm, fromArg, toArg, option);
+        int from = parseNode(graph, fromArg);
+        int to = parseNode(graph, toArg);
+
+        if (fields < 1)
+            continue;
+        if (strcmp(algorithm, "quit") == 0)
         {
-            printf("distance: %i time: ", node->startDist);
-            printDrivingTime(node->startDist);
-            printf(" ");
-            findPath(graph, route);
-            printf("nodes: %i\n", route->numNodes);
+            quit = true;
             break;
         }
 
-        // check all neighbors and update distances
-        for (Edge *edge = graph->nodes[nodeNr].edgeHead; edge != NULL; edge = edge->next)
+        char mode = MODE_DJIKSTRA;
+        if (strcmp(algorithm, "alt") == 0)
+            mode = MODE_ALT;
+        else if (strcmp(algorithm, "astar") == 0)
+            mode = MODE_ASTAR;
+
+        if (fields < 3)
+            fprintf(out, "error usage: djik|alt|astar <from> <to> [path|polyline]\n");
+        else if (mode == MODE_DJIKSTRA && strcmp(algorithm, "djik") != 0)
+            fprintf(out, "error unknown algorithm %s\n", algorithm);
+        else if (mode == MODE_ALT && graph->m == 0)
+            fprintf(out, "error no landmarks loaded\n");
+        else if (from < 0 || to < 0)
+            fprintf(out, "error nodes must be in [0, %i) or lat,lon\n", graph->n);
+        else
         {
-            Node *neighbor = edge->to;
-            int newNeighborDist = node->startDist + edge->weight;
+            Route *route = initRoute(from, to);
+            double startTime = wallTime();
+            djikstra(graph, search, route, true, mode, NULL, 0);
+            double queryTime = wallTime() - startTime;
 
-            if (mode == MODE_ALT && neighbor->estimateToGoal == 0)
+            if (route->distance >= infinity)
             {
-                neighbor->estimateToGoal = estimateALT(graph, route->destination, neighbor->nr);
-                if (neighbor->estimateToGoal < 0)
-                    printf("estimateALT returned negative  ");
+                fprintf(out, "none\n");
             }
-
-            if (!neighbor->checked &&
-                newNeighborDist < neighbor->startDist &&
-                newNeighborDist + neighbor->estimateToGoal < neighbor->weight)
+            else
             {
-                neighbor->weight = newNeighborDist + neighbor->estimateToGoal;
-                neighbor->startDist = newNeighborDist;
-                neighbor->previous = node;
-                heapInsert(heap, neighbor->nr, graph->nodes);
+                char time[32];
+                formatDrivingTime(time, sizeof(time), route->distance);
+                fprintf(out, "ok %i %s %i %.3f\n",
+                        route->distance, time, route->numNodes, queryTime * 1000);
+                if (strcmp(option, "path") == 0)
+                {
+                    outString(buffer, "path");
+                    for (int i = 0; i < route->numNodes; i++)
+                    {
+                        outChar(buffer, ' ');
+                        outInt(buffer, graph->nr[route->path[i]]);
+                    }
+                    outChar(buffer, '\n');
+                }
+                else if (strcmp(option, "polyline") == 0)
+                {
+                    bool *keep = malloc(route->numNodes * sizeof(bool));
+                    simplifyPath(graph, route->path, route->numNodes, simplifyTolerance, keep);
+                    outString(buffer, "polyline ");
+                    outPolyline(buffer, graph, route->path, keep, route->numNodes);
+                    outChar(buffer, '\n');
+                    free(keep);
+                }
+                outFlush(buffer);
             }
+            freeRoute(route);
         }
+        fflush(out);
     }
+    free(buffer);
+    return quit;
+}
 
-    free(heap);
+// each worker serves one connection at a time until the client closes it
+void *serverWorker(void *arg)
+{
+    Server *server = arg;
+    SearchContext *search = initSearch(server->graph);
+    pthread_mutex_lock(&server->lock);
+    int index = server->numStarted++;
+    pthread_mutex_unlock(&server->lock);
 
-    printf("queueWeightSmallerCount: %i\n", queueWeightSmallerCount);
+    while (true)
+    {
+        int fd = accept(server->listenFd, NULL, NULL);
+        if (fd < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (!server->stopping)
+                perror("Error while accepting connection");
+            break;
+        }
 
-    float endTime = (float)clock() / CLOCKS_PER_SEC;
-    float timeElapsed = endTime - startTime;
-    printf("%s done in %.2fs, checked:%i duplicates:%i\n",
-           mode == MODE_ALT ? "ALT" : "Djikstra", timeElapsed, checked, duplicateNodes);
+        pthread_mutex_lock(&server->lock);
+        bool stopping = server->stopping;
+        if (!stopping)
+            server->clients[index] = fd;
+        pthread_mutex_unlock(&server->lock);
+        if (stopping)
+        {
+            close(fd);
+            break;
+        }
+
+        int outFd = dup(fd);
+        FILE *in = fdopen(fd, "r");
+        FILE *out = outFd < 0 ? NULL : fdopen(outFd, "w");
+        if (in != NULL && out != NULL)
+            serveQueries(server, search, in, out);
+        else
+            perror("Error while opening connection");
+
+        pthread_mutex_lock(&server->lock);
+        server->clients[index] = -1;
+        pthread_mutex_unlock(&server->lock);
+        if (in != NULL)
+            fclose(in);
+        else
+            close(fd);
+        if (out != NULL)
+            fclose(out);
+        else if (outFd >= 0)
+            close(outFd);
+    }
+
+    freeSearch(search);
+    return NULL;
 }
 
-// preProcess(norNode, norEdge, norPoi, norPre, landmarks, m);
-void preProcess(char nodeFile[], char edgeFile[], char poiFile[],
-                char outFile[], int landmarks[], int m)
+int openSocket(char socketPath[])
 {
-    printf("preprocessing %i landmarks\n", m);
-    float startTime = (float)clock() / CLOCKS_PER_SEC;
+    struct sockaddr_un address = {0};
+    address.sun_family = AF_UNIX;
+    if (strlen(socketPath) >= sizeof(address.sun_path))
+    {
+        fprintf(stderr, "socket path too long: %s\n", socketPath);
+        exit(1);
+    }
+    strcpy(address.sun_path, socketPath);
 
-    Graph *graph = readGraph(nodeFile, edgeFile, poiFile, false);
-    Graph *graphRev = readGraph(nodeFile, edgeFile, poiFile, true);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+        perror("Error while creating socket");
+        exit(1);
+    }
 
-    int *fromMarks = calloc(m * graph->n, sizeof(int));
-    int *toMarks = calloc(m * graphRev->n, sizeof(int));
+    unlink(socketPath);
+    if (bind(fd, (struct sockaddr *)&address, sizeof(address)) < 0 || listen(fd, 64) < 0)
+    {
+        perror("Error while binding socket");
+        exit(1);
+    }
+    return fd;
+}
 
-    for (int i = 0; i < m; i++)
+// stops accepting and ends the open connections, the workers then return
+void stopServer(Server *server)
+{
+    pthread_mutex_lock(&server->lock);
+    server->stopping = true;
+    shutdown(server->listenFd, SHUT_RDWR);
+    for (int t = 0; t < server->numWorkers; t++)
     {
-        int landmark = landmarks[i];
-        printf("\nprocessing landmark %s (%i)",
-               graph->nodes[landmark].name, landmark);
-        Route *route = initRoute(landmark, -1);
+        if (server->clients[t] >= 0)
+            shutdown(server->clients[t], SHUT_RDWR);
+    }
+    pthread_mutex_unlock(&server->lock);
+}
 
-        resetNodes(graph, route, landmark);
-        djikstra(graph, route, false, MODE_DJIKSTRA, NULL, 0);
+// serves stdin on the main thread and, with a socket path, connections on
+// a pool of numThreads() workers, quit on stdin stops the server, at the end
+// of stdin it keeps running for the socket until SIGINT or SIGTERM
+void routeTerminal(char nodeFile[], char edgeFile[], char poiFile[], char preFile[],
+                   char socketPath[])
+{
+    Server server = {0};
+    server.graph = loadGraph(nodeFile, edgeFile, poiFile);
+    server.listenFd = -1;
+    if (strcmp(preFile, "-") != 0)
+        loadPreProcess(server.graph, preFile);
+    // built before the workers start, snapNode would build it lazily
+    buildSpatialIndex(server.graph);
+    quiet = true;
+
+    pthread_t *threads = NULL;
+    sigset_t stopSignals, unblocked;
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGINT);
+    sigaddset(&stopSignals, SIGTERM);
+    if (socketPath != NULL)
+    {
+        // a client that hangs up mid-answer must not kill the server
+        signal(SIGPIPE, SIG_IGN);
+        struct sigaction action = {0};
+        action.sa_handler = onStopSignal;
+        sigaction(SIGINT, &action, NULL);
+        sigaction(SIGTERM, &action, NULL);
+        // only the main thread takes the stop signals, without SA_RESTART
+        // they interrupt its read from stdin
+        pthread_sigmask(SIG_BLOCK, &stopSignals, &unblocked);
+
+        server.listenFd = openSocket(socketPath);
+        server.numWorkers = numThreads();
+        server.clients = malloc(server.numWorkers * sizeof(int));
+        pthread_mutex_init(&server.lock, NULL);
+        threads = malloc(server.numWorkers * sizeof(pthread_t));
+        for (int t = 0; t < server.numWorkers; t++)
+        {
+            server.clients[t] = -1;
+            pthread_create(&threads[t], NULL, serverWorker, &server);
+        }
+        pthread_sigmask(SIG_SETMASK, &unblocked, NULL);
+        printf("serving %s with %i workers\n", socketPath, server.numWorkers);
+    }
 
-        resetNodes(graphRev, route, landmark);
-        djikstra(graphRev, route, false, MODE_DJIKSTRA, NULL, 0);
+    printf("queries: djik|alt|astar <from|lat,lon> <to|lat,lon> [path|polyline], quit\n");
+    fflush(stdout);
+    SearchContext *search = initSearch(server.graph);
+    bool quit = serveQueries(&server, search, stdin, stdout);
+    freeSearch(search);
 
-        for (int j = 0; j < graph->n; j++)
+    if (socketPath != NULL)
+    {
+        if (!quit)
+        {
+            // blocked between the check and sigsuspend so no signal is missed
+            pthread_sigmask(SIG_BLOCK, &stopSignals, NULL);
+            while (!stopSignal)
+                sigsuspend(&unblocked);
+        }
+        stopServer(&server);
+        for (int t = 0; t < server.numWorkers; t++)
         {
-            *(fromMarks + j * m + i) = graph->nodes[j].weight;
-            *(toMarks + j * m + i) = graphRev->nodes[j].weight;
+            pthread_join(threads[t], NULL);
         }
+        close(server.listenFd);
+        unlink(socketPath);
+        pthread_mutex_destroy(&server.lock);
+        free(server.clients);
+        free(threads);
+        printf("server stopped\n");
     }
+    exit(0);
+}
 
-    FILE *fpOut = fopen(outFile, "wb");
-    if (fpOut == NULL)
+// origin-destination pairs shared by the batch threads, results are
+// stored by index so the output keeps the input order
+typedef struct BatchJobsStruct
+{
+    Graph *graph;
+    char mode;
+    int numQueries;
+    int *from;
+    int *to;
+    int *distance;
+    double *latency; // seconds
+    int next;
+    pthread_mutex_t lock;
+} BatchJobs;
+
+void *batchWorker(void *arg)
+{
+    BatchJobs *jobs = arg;
+    SearchContext *search = initSearch(jobs->graph);
+
+    while (true)
     {
-        perror("Error while opening file");
-        exit(1);
+        pthread_mutex_lock(&jobs->lock);
+        int q = jobs->next < jobs->numQueries ? jobs->next++ : -1;
+        pthread_mutex_unlock(&jobs->lock);
+        if (q < 0)
+            break;
+
+        Route *route = initRoute(jobs->from[q], jobs->to[q]);
+        double startTime = wallTime();
+        djikstra(jobs->graph, search, route, true, jobs->mode, NULL, 0);
+        jobs->latency[q] = wallTime() - startTime;
+        jobs->distance[q] = route->distance;
+        freeRoute(route);
     }
 
-    // m landmarks, landmark ids,
-    // m*n ints (from node n to landmark n1,n2...), m*n ints (to node...)
-    fwrite(&m, sizeof(m), 1, fpOut);
-    fwrite(landmarks, sizeof(int), m, fpOut);
-    fwrite(fromMarks, sizeof(int), m * graph->n, fpOut);
-    fwrite(toMarks, sizeof(int), m * graph->n, fpOut);
+    freeSearch(search);
+    return NULL;
+}
 
-    float endTime = (float)clock() / CLOCKS_PER_SEC;
-    float timeElapsed = endTime - startTime;
-    printf("preprocessed %i landmarks for %i nodes in %.2fs\n",
-           m, graph->n, timeElapsed);
-    exit(0);
+int compareDoubles(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
 }
 
-void loadPreProcess(Graph *graph, char preFile[])
+// runs every "from to" line of pairsFile on all cores and writes
+// from,to,distance,time in input order, -1 for unreachable destinations
+void runBatch(char nodeFile[], char edgeFile[], char poiFile[], char preFile[],
+              char pairsFile[], char outFile[], char mode)
 {
-    printf("loading preprocessed landmarks from %s\n", preFile);
-    float startTime = (float)clock() / CLOCKS_PER_SEC;
+    Graph *graph = loadGraph(nodeFile, edgeFile, poiFile);
+    if (strcmp(preFile, "-") != 0)
+        loadPreProcess(graph, preFile);
+    if (mode == MODE_ALT && graph->m == 0)
+    {
+        fprintf(stderr, "alt needs a landmark file\n");
+        exit(1);
+    }
 
-    FILE *fp = fopen(preFile, "rb");
-    if (fp == NULL)
+    FILE *fpPairs = fopen(pairsFile, "r");
+    if (fpPairs == NULL)
     {
         perror("Error while opening file");
         exit(1);
     }
 
-    int m;
-    fread(&m, sizeof(int), 1, fp);
-    int *landmarks = calloc(m, sizeof(int));
-    fread(landmarks, sizeof(int), m, fp);
-    int *fromMarks = calloc(m * graph->n, sizeof(int));
-    int *toMarks = calloc(m * graph->n, sizeof(int));
-    fread(fromMarks, sizeof(int), m * graph->n, fp);
-    fread(toMarks, sizeof(int), m * graph->n, fp);
+    BatchJobs jobs = {0};
+    jobs.graph = graph;
+    jobs.mode = mode;
+    int capacity = 1024;
+    jobs.from = malloc(capacity * sizeof(int));
+    jobs.to = malloc(capacity * sizeof(int));
 
-    graph->m = m;
-    graph->fromMarks = fromMarks;
-    graph->toMarks = toMarks;
+    char line[64];
+    int lineNr = 0;
+    while (fgets(line, sizeof(line), fpPairs))
+    {
+        lineNr++;
+        int from, to;
+        int fields = sscanf(line, "%d %d", &from, &to);
+        if (fields <= 0)
+            continue;
+        if (fields == 2)
+        {
+            from = graphNode(graph, from);
+            to = graphNode(graph, to);
+        }
+        if (fields != 2 || from < 0 || to < 0)
+        {
+            fprintf(stderr, "%s:%i: expected <from> <to> in [0, %i)\n", pairsFile, lineNr, graph->n);
+            exit(1);
+        }
 
-    float endTime = (float)clock() / CLOCKS_PER_SEC;
-    float timeElapsed = endTime - startTime;
-    printf("loaded %i landmarks for %i nodes in %.2fs\n",
-           m, graph->n, timeElapsed);
-}
+        if (jobs.numQueries == capacity)
+        {
+            capacity *= 2;
+            jobs.from = realloc(jobs.from, capacity * sizeof(int));
+            jobs.to = realloc(jobs.to, capacity * sizeof(int));
+        }
+        jobs.from[jobs.numQueries] = from;
+        jobs.to[jobs.numQueries] = to;
+        jobs.numQueries++;
+    }
+    fclose(fpPairs);
+
+    jobs.distance = malloc(jobs.numQueries * sizeof(int));
+    jobs.latency = malloc(jobs.numQueries * sizeof(double));
+    pthread_mutex_init(&jobs.lock, NULL);
+
+    int threads = numThreads();
+    printf("running %i %s queries on %i threads\n",
+           jobs.numQueries, mode == MODE_ALT ? "ALT" : (mode == MODE_ASTAR ? "A*" : "Djikstra"),
+           threads);
+    quiet = true;
+    double startTime = wallTime();
+
+    pthread_t workers[threads];
+    for (int t = 0; t < threads; t++)
+    {
+        pthread_create(&workers[t], NULL, batchWorker, &jobs);
+    }
+    for (int t = 0; t < threads; t++)
+    {
+        pthread_join(workers[t], NULL);
+    }
+    double timeElapsed = wallTime() - startTime;
+    pthread_mutex_destroy(&jobs.lock);
 
-void writeStations(Graph *graph, char mode, int stations[], int n, char outFile[])
-{
     FILE *fpOut = fopen(outFile, "w");
     if (fpOut == NULL)
     {
         perror("Error while opening outfile");
         exit(1);
     }
-
-    char csvColumns[] = "mode,node,latitude,longitude\n";
-    fwrite(csvColumns, strlen(csvColumns), 1, fpOut);
-    // up to 3 chars for negative, 1 dot, 7 decimals, and 1 string termination
-    const int coordLength = 12;
-
-    char modeChar = '0';
-    if (mode == MODE_FUEL)
+    fprintf(fpOut, "from,to,distance,time\n");
+    for (int q = 0; q < jobs.numQueries; q++)
     {
-        modeChar = '2';
+        if (jobs.distance[q] >= infinity)
+        {
+            fprintf(fpOut, "%i,%i,-1,\n", graph->nr[jobs.from[q]], graph->nr[jobs.to[q]]);
+            continue;
+        }
+        char time[32];
+        formatDrivingTime(time, sizeof(time), jobs.distance[q]);
+        fprintf(fpOut, "%i,%i,%i,%s\n", graph->nr[jobs.from[q]], graph->nr[jobs.to[q]],
+                jobs.distance[q], time);
     }
-    else if (mode == MODE_CHARGER)
+    fclose(fpOut);
+
+    if (jobs.numQueries > 0)
     {
-        modeChar = '4';
+        qsort(jobs.latency, jobs.numQueries, sizeof(double), compareDoubles);
+        int n = jobs.numQueries;
+        printf("%i queries in %.2fs, %.1f queries/s\n", n, timeElapsed, n / timeElapsed);
+        printf("latency p50: %.3fms p95: %.3fms p99: %.3fms max: %.3fms\n",
+               jobs.latency[(n - 1) * 50 / 100] * 1000, jobs.latency[(n - 1) * 95 / 100] * 1000,
+               jobs.latency[(n - 1) * 99 / 100] * 1000, jobs.latency[n - 1] * 1000);
     }
+    printf("distances written to %s\n", outFile);
+    exit(0);
+}
 
-    for (int i = 0; i < n; i++)
+// fills matrix[s * numTargets + t] with the distance from sources[s] to
+// targets[t], infinity if unreachable. matrixDjikstra is the only solver
+// so far, faster ones (e.g. bucket based) can replace it in runMatrix
+typedef void (*MatrixSolver)(Graph *graph, int sources[], int numSources,
+                             int targets[], int numTargets, int matrix[]);
+
+typedef struct MatrixJobsStruct
+{
+    Graph *graph;
+    int *sources;
+    int numSources;
+    int *targets;
+    int numTargets;
+    bool *isTarget;
+    int distinctTargets;
+    int *matrix;
+    int next;
+    pthread_mutex_t lock;
+} MatrixJobs;
+
+void *matrixWorker(void *arg)
+{
+    MatrixJobs *jobs = arg;
+    SearchContext *search = initSearch(jobs->graph);
+
+    while (true)
     {
-        char nodeNr[30];
-        char lat[coordLength], lon[coordLength];
-        snprintf(nodeNr, 30, "%i", graph->nodes[stations[i]].nr);
-        snprintf(lat, coordLength, "%.8f", graph->nodes[stations[i]].lat);
-        snprintf(lon, coordLength, "%.8f", graph->nodes[stations[i]].lon);
-
-        fwrite(&modeChar, sizeof(char), 1, fpOut);
-        fwrite(",", sizeof(char), 1, fpOut);
-        fwrite(nodeNr, sizeof(char), strlen(nodeNr), fpOut);
-        fwrite(",", sizeof(char), 1, fpOut);
-        fwrite(lat, sizeof(char), strlen(lat), fpOut);
-        fwrite(",", sizeof(char), 1, fpOut);
-        fwrite(lon, sizeof(char), strlen(lat), fpOut);
-        fwrite("\n", sizeof(char), 1, fpOut);
+        pthread_mutex_lock(&jobs->lock);
+        int s = jobs->next < jobs->numSources ? jobs->next++ : -1;
+        pthread_mutex_unlock(&jobs->lock);
+        if (s < 0)
+            break;
+
+        // stop as soon as every target is settled
+        searchReset(search, jobs->sources[s]);
+        int found = 0;
+        int nodeNr;
+        while (found < jobs->distinctTargets && (nodeNr = searchStep(jobs->graph, search)) >= 0)
+        {
+            if (jobs->isTarget[nodeNr])
+                found++;
+        }
+
+        int *row = jobs->matrix + (long)s * jobs->numTargets;
+        for (int t = 0; t < jobs->numTargets; t++)
+        {
+            row[t] = searchDist(search, jobs->targets[t]);
+        }
     }
-    printf("coordinates written to %s\n", outFile);
+
+    freeSearch(search);
+    return NULL;
 }
 
-void findStations(Graph *graph, Route *route, char outFile[], char mode, int n)
+// one Djikstra per source, parallel over the sources
+void matrixDjikstra(Graph *graph, int sources[], int numSources,
+                    int targets[], int numTargets, int matrix[])
 {
-    int stations[n];
-    for (int i = 0; i < n; i++)
+    MatrixJobs jobs = {0};
+    jobs.graph = graph;
+    jobs.sources = sources;
+    jobs.numSources = numSources;
+    jobs.targets = targets;
+    jobs.numTargets = numTargets;
+    jobs.matrix = matrix;
+    jobs.isTarget = calloc(graph->n, sizeof(bool));
+    for (int t = 0; t < numTargets; t++)
     {
-        stations[i] = 0;
+        if (!jobs.isTarget[targets[t]])
+            jobs.distinctTargets++;
+        jobs.isTarget[targets[t]] = true;
     }
-    djikstra(graph, route, false, mode, stations, n);
-    writeStations(graph, mode, stations, n, outFile);
+    pthread_mutex_init(&jobs.lock, NULL);
+
+    int threads = numThreads();
+    pthread_t workers[threads];
+    for (int t = 0; t < threads; t++)
+    {
+        pthread_create(&workers[t], NULL, matrixWorker, &jobs);
+    }
+    for (int t = 0; t < threads; t++)
+    {
+        pthread_join(workers[t], NULL);
+    }
+    pthread_mutex_destroy(&jobs.lock);
+    free(jobs.isTarget);
 }
 
-void runFindStations(char nodeFile[], char edgeFile[], char poiFile[], char outFile[],
-                     char mode, int n, int node)
+// node ids, one per line
+int *readNodeList(char file[], Graph *graph, int *count)
 {
-    printf("\n nodes:%s edges:%s pois:%s\n", nodeFile, edgeFile, poiFile);
-    Graph *graph = readGraph(nodeFile, edgeFile, poiFile, false);
-    initNodeDistances(graph, node);
-    Route *route = initRoute(node, -1);
+    FILE *fp = fopen(file, "r");
+    if (fp == NULL)
+    {
+        perror("Error while opening file");
+        exit(1);
+    }
 
-    findStations(graph, route, outFile, mode, n);
-    exit(0);
+    int capacity = 256;
+    int *nodes = malloc(capacity * sizeof(int));
+    *count = 0;
+    int node;
+    while (fscanf(fp, "%d", &node) == 1)
+    {
+        int index = graphNode(graph, node);
+        if (index < 0)
+        {
+            fprintf(stderr, "%s: node %i not in [0, %i)\n", file, node, graph->n);
+            exit(1);
+        }
+        if (*count == capacity)
+        {
+            capacity *= 2;
+            nodes = realloc(nodes, capacity * sizeof(int));
+        }
+        nodes[(*count)++] = index;
+    }
+    fclose(fp);
+    return nodes;
 }
 
-void writeCheckedNodes(Graph *graph, char outFile[])
+// CSV has a header row of targets and one row per source, -1 for unreachable,
+// binary is int32 S, T, the source ids, the target ids and S * T distances
+// with infinity for unreachable
+void writeMatrix(int sources[], int numSources, int targets[], int numTargets,
+                 int matrix[], char outFile[], bool binary)
 {
-    FILE *fpOut = fopen(outFile, "w");
+    FILE *fpOut = fopen(outFile, binary ? "wb" : "w");
     if (fpOut == NULL)
     {
         perror("Error while opening outfile");
         exit(1);
     }
 
-    char csvColumns[] = "nr,node,latitude,longitude\n";
-    fwrite(csvColumns, strlen(csvColumns), 1, fpOut);
-    // up to 3 chars for negative, 1 dot, 7 decimals, and 1 string termination
-    const int coordLength = 12;
-
-    for (int i = 0; i < graph->n; i++)
+    if (binary)
     {
-        if (!graph->nodes[i].checked)
-            continue;
-
-        if (i % 100 != 0)
-            continue;
+        int32_t header[2] = {numSources, numTargets};
+        fwrite(header, sizeof(int32_t), 2, fpOut);
+        fwrite(sources, sizeof(int), numSources, fpOut);
+        fwrite(targets, sizeof(int), numTargets, fpOut);
+        fwrite(matrix, sizeof(int), (long)numSources * numTargets, fpOut);
+        fclose(fpOut);
+        return;
+    }
 
-        char pathNr[10] = {0};
-        char nodeNr[30] = {0};
-        char lat[coordLength];
-        char lon[coordLength];
-        memset(lat, 0, coordLength);
-        memset(lon, 0, coordLength);
-        snprintf(pathNr, 10, "%i", i + 1);
-        snprintf(nodeNr, 30, "%i", graph->nodes[i].nr);
-        snprintf(lat, coordLength, "%.7f", graph->nodes[i].lat);
-        snprintf(lon, coordLength, "%.7f", graph->nodes[i].lon);
-
-        fwrite(pathNr, sizeof(char), strlen(pathNr), fpOut);
-        fwrite(",", sizeof(char), 1, fpOut);
-        fwrite(nodeNr, sizeof(char), strlen(nodeNr), fpOut);
-        fwrite(",", sizeof(char), 1, fpOut);
-        fwrite(lat, sizeof(char), strlen(lat), fpOut);
-        fwrite(",", sizeof(char), 1, fpOut);
-        fwrite(lon, sizeof(char), strlen(lon), fpOut);
-        fwrite("\n", sizeof(char), 1, fpOut);
+    fprintf(fpOut, "source");
+    for (int t = 0; t < numTargets; t++)
+    {
+        fprintf(fpOut, ",%i", targets[t]);
     }
-    printf("checked coordinates written to %s\n", outFile);
+    fprintf(fpOut, "\n");
+    for (int s = 0; s < numSources; s++)
+    {
+        fprintf(fpOut, "%i", sources[s]);
+        for (int t = 0; t < numTargets; t++)
+        {
+            int dist = matrix[(long)s * numTargets + t];
+            fprintf(fpOut, ",%i", dist < infinity ? dist : -1);
+        }
+        fprintf(fpOut, "\n");
+    }
+    fclose(fpOut);
 }
 
-void shortestPath(char nodeFile[], char edgeFile[], char poiFile[], char preFile[], char outFile[],
-                  char mode, int from, int to)
+void runMatrix(char nodeFile[], char edgeFile[], char poiFile[], char sourceFile[],
+               char targetFile[], char outFile[], bool binary)
 {
-    printf("nodes:%s edges:%s pois:%s\n", nodeFile, edgeFile, poiFile);
-    Graph *graph = readGraph(nodeFile, edgeFile, poiFile, false);
-    initNodeDistances(graph, from);
-    Route *route = initRoute(from, to);
-
-    if (preFile != NULL)
-        loadPreProcess(graph, preFile);
-
-    djikstra(graph, route, true, mode, NULL, 0);
-    if (!(route->destination < 0))
+    Graph *graph = loadGraph(nodeFile, edgeFile, poiFile);
+    int numSources, numTargets;
+    int *sources = readNodeList(sourceFile, graph, &numSources);
+    int *targets = readNodeList(targetFile, graph, &numTargets);
+    int *matrix = malloc((long)numSources * numTargets * sizeof(int));
+
+    MatrixSolver solver = matrixDjikstra;
+    double startTime = wallTime();
+    solver(graph, sources, numSources, targets, numTargets, matrix);
+    printf("%ix%i matrix in %.2fs on %i threads\n",
+           numSources, numTargets, wallTime() - startTime, numThreads());
+
+    // back to node ids for the output
+    for (int i = 0; i < numSources; i++)
+    {
+        sources[i] = graph->nr[sources[i]];
+    }
+    for (int i = 0; i < numTargets; i++)
     {
-        writePath(route, outFile);
+        targets[i] = graph->nr[targets[i]];
     }
+    writeMatrix(sources, numSources, targets, numTargets, matrix, outFile, binary);
+    printf("matrix written to %s\n", outFile);
     exit(0);
 }
 
-void routeTerminal(char preFile[])
+// node argument of a subcommand as an index into the graph, node ids are
+// mapped for reordered snapshots and "lat,lon" is snapped to the nearest node
+int nodeArg(char nodeFile[], char edgeFile[], char poiFile[], char arg[])
 {
-    printf("pre file: %s\n", preFile);
-
-    char input[12];
-    char algorithm[5];
-    int from = 0;
-    int to = 0;
-    char outFile[100];
-    printf("djik <from> <to> [file]:\n");
-
-    while (fgets(input, 12, stdin))
+    Graph *graph = loadGraph(nodeFile, edgeFile, poiFile);
+    if (strchr(arg, ',') == NULL)
     {
-        sscanf(input, "%5s %d %d %5s", algorithm, &from, &to, outFile);
-        printf("alg: %s from: %d to: %d outfile: %s", algorithm, from, to, outFile);
-        if (strncmp(input, "a", 1) == 0)
+        int node = parseNode(graph, arg);
+        if (node < 0)
         {
-            sleep(2);
+            fprintf(stderr, "invalid node %s, expected [0, %i) or lat,lon\n", arg, graph->n);
+            exit(1);
         }
-        sleep(1);
+        return node;
+    }
 
-        printf("\r\33[2K"); // VT100 clear line escape code
-        printf("\rdjik <from> <to> [file]:\n");
+    if (graph->spatial == NULL)
+        buildSpatialIndex(graph);
+    double startTime = wallTime();
+    int node = parseNode(graph, arg);
+    if (node < 0)
+    {
+        fprintf(stderr, "invalid coordinates %s, expected lat,lon\n", arg);
+        exit(1);
     }
+    printf("snapped %s to node %i (%.6f,%.6f) in %.1fus\n", arg, graph->nr[node],
+           graph->lat[node], graph->lon[node], (wallTime() - startTime) * 1e6);
+    return node;
+}
+
+// returns the exit code for bad arguments
+int printUsage(char program[])
+{
+    printf("usage:\n"
+           "Convert to snapshot: %1$s convert <nodes> <edges> <poi> <out>\n"
+           "Pre-process ALT: %1$s pre <nodes> <edges> <poi> <out> <landmark> [landmark2..]\n"
+           "Pre-process ALT: %1$s pre <nodes> <edges> <poi> <out> farthest|avoid|planar <m> [center]\n"
+           "  up to %2$i landmarks\n"
+           "  landmark searches run on all cores, set DALT_THREADS to limit\n"
+           "  distances are stored in 16 bits and the file is mapped, it only fits the graph it was made for\n"
+           "Set DALT_VALIDATE=1 to check heap order and ALT estimates while searching\n"
+           "Set DALT_QUEUE=radix to use a radix heap for Djikstra and landmark searches\n"
+           "Set DALT_SIMPLIFY to the route simplification tolerance in meters, 0 keeps every node\n"
+           "Benchmark queues: %1$s bench <nodes> <edges> <poi> [searches]\n"
+           "Compare searches: %1$s compare <nodes> <edges> <poi> <pre|-> [queries]\n"
+           "Reorder nodes: %1$s reorder <nodes> <edges> <poi> <out> [hilbert|dfs] [queries]\n"
+           "  writes a snapshot in cache friendly node order, node ids stay the same\n"
+           "Djikstra: %1$s djik <nodes> <edges> <poi> <out> <from> <to>\n"
+           "A*: %1$s astar <nodes> <edges> <poi> <out> <from> <to>\n"
+           "  great-circle distance over the fastest edge speed, needs no pre-processing\n"
+           "Bidirectional Djikstra: %1$s bidi <nodes> <edges> <poi> <out> <from> <to>\n"
+           "ALT: %1$s alt <nodes> <edges> <poi> <pre> <out> <from> <to>\n"
+           "Bidirectional ALT: %1$s balt <nodes> <edges> <poi> <pre> <out> <from> <to>\n"
+           "Pre-process CH: %1$s ch-pre <nodes> <edges> <poi> <out>\n"
+           "Contraction hierarchies: %1$s ch <nodes> <edges> <poi> <ch> <out> <from> <to>\n"
+           "Query server: %1$s route <nodes> <edges> <poi> <pre|-> [socket]\n"
+           "  reads djik|alt|astar <from> <to> [path|polyline] from stdin and the unix socket\n"
+           "Batch queries: %1$s batch <nodes> <edges> <poi> <pre|-> <pairs> <out> [djik|alt|astar]\n"
+           "  <pairs> has one <from> <to> per line, runs on all cores\n"
+           "Distance matrix: %1$s matrix <nodes> <edges> <poi> <sources> <targets> <out> [csv|bin]\n"
+           "  <sources> and <targets> have one node per line\n"
+           "Find stations: %1$s fuel|charger <nodes> <edges> <poi> <out> n <node>\n"
+           "Pre-process nearest stations: %1$s station-pre <nodes> <edges> <poi> <out>\n"
+           "Stations along a route: %1$s detour <nodes> <edges> <poi> <pre|-> <out> fuel|charger n <from> <to>\n"
+           "Isochrone: %1$s iso <nodes> <edges> <poi> <out> <node> <seconds> [reverse] [boundary]\n"
+           "  nodes reachable from <node> (or that reach it with reverse)\n"
+           "Nearest station: %1$s nearest <nodes> <edges> <poi> <index> fuel|charger <node>\n"
+           "Paths, stations and isochrones are written to <out> as GeoJSON for .geojson or .json,\n"
+           "  an encoded polyline for .polyline and csv otherwise\n"
+           "<nodes> can be a snapshot from convert, <edges> and <poi> are then ignored (use -)\n"
+           "<node>, <from> and <to> can be lat,lon, snapped to the nearest node\n",
+           program, LANDMARKS_MAX);
+    return 1;
 }
 
 int main(int argc, char *argv[])
 {
-    if (argc > 3 && strcmp(argv[1], "route") == 0)
+    validate = getenv("DALT_VALIDATE") != NULL && atoi(getenv("DALT_VALIDATE")) != 0;
+    radixQueue = getenv("DALT_QUEUE") != NULL && strcmp(getenv("DALT_QUEUE"), "radix") == 0;
+    if (getenv("DALT_SIMPLIFY") != NULL)
+        simplifyTolerance = atof(getenv("DALT_SIMPLIFY"));
+
+    if (argc > 5 && strcmp(argv[1], "route") == 0)
+    {
+        routeTerminal(argv[2], argv[3], argv[4], argv[5], argc > 6 ? argv[6] : NULL);
+        return 0;
+    }
+    else if (argc > 7 && strcmp(argv[1], "batch") == 0)
+    {
+        char mode = MODE_DJIKSTRA;
+        if (argc > 8 && strcmp(argv[8], "alt") == 0)
+            mode = MODE_ALT;
+        else if (argc > 8 && strcmp(argv[8], "astar") == 0)
+            mode = MODE_ASTAR;
+        runBatch(argv[2], argv[3], argv[4], argv[5], argv[6], argv[7], mode);
+        return 0;
+    }
+    else if (argc > 7 && strcmp(argv[1], "matrix") == 0)
+    {
+        bool binary = argc > 8 && strcmp(argv[8], "bin") == 0;
+        runMatrix(argv[2], argv[3], argv[4], argv[5], argv[6], argv[7], binary);
+        return 0;
+    }
+    else if (argc > 5 && strcmp(argv[1], "convert") == 0)
+    {
+        convertGraph(argv[2], argv[3], argv[4], argv[5]);
+        return 0;
+    }
+    else if (argc > 7 && strcmp(argv[1], "pre") == 0 &&
+             (strcmp(argv[6], "farthest") == 0 || strcmp(argv[6], "avoid") == 0 ||
+              strcmp(argv[6], "planar") == 0))
     {
-        routeTerminal(argv[2]);
+        int strategy = LANDMARKS_FARTHEST;
+        if (strcmp(argv[6], "avoid") == 0)
+            strategy = LANDMARKS_AVOID;
+        else if (strcmp(argv[6], "planar") == 0)
+            strategy = LANDMARKS_PLANAR;
+
+        int m = atoi(argv[7]);
+        if (m < 1 || m > LANDMARKS_MAX)
+            return printUsage(argv[0]);
+        int center = argc > 8 ? nodeArg(argv[2], argv[3], argv[4], argv[8]) : -1;
+        int landmarks[m];
+        preProcess(argv[2], argv[3], argv[4], argv[5], landmarks, m, strategy, center);
         return 0;
     }
     else if (argc > 6 && strcmp(argv[1], "pre") == 0)
     {
         int m = argc - 6;
+        if (m > LANDMARKS_MAX)
+            return printUsage(argv[0]);
         int landmarks[m];
         for (int i = 0; i < m; i++)
         {
-            landmarks[i] = atoi(argv[6 + i]);
+            landmarks[i] = nodeArg(argv[2], argv[3], argv[4], argv[6 + i]);
         }
 
-        preProcess(argv[2], argv[3], argv[4], argv[5], landmarks, m);
+        preProcess(argv[2], argv[3], argv[4], argv[5], landmarks, m, LANDMARKS_GIVEN, -1);
         return 0;
     }
     else if (argc > 7 && strcmp(argv[1], "djik") == 0)
     {
-        int from = atoi(argv[6]);
-        int to = atoi(argv[7]);
+        int from = nodeArg(argv[2], argv[3], argv[4], argv[6]);
+        int to = nodeArg(argv[2], argv[3], argv[4], argv[7]);
         shortestPath(argv[2], argv[3], argv[4], NULL, argv[5], MODE_DJIKSTRA, from, to);
         return 0;
     }
+    else if (argc > 5 && strcmp(argv[1], "reorder") == 0)
+    {
+        bool dfs = argc > 6 && strcmp(argv[6], "dfs") == 0;
+        int queries = argc > 7 ? atoi(argv[7]) : 200;
+        runReorder(argv[2], argv[3], argv[4], argv[5], dfs, queries);
+        return 0;
+    }
+    else if (argc > 4 && strcmp(argv[1], "bench") == 0)
+    {
+        int searches = argc > 5 ? atoi(argv[5]) : 20;
+        benchQueues(argv[2], argv[3], argv[4], searches);
+        return 0;
+    }
+    else if (argc > 5 && strcmp(argv[1], "ch-pre") == 0)
+    {
+        chPreProcess(argv[2], argv[3], argv[4], argv[5]);
+        return 0;
+    }
+    else if (argc > 8 && strcmp(argv[1], "ch") == 0)
+    {
+        int from = nodeArg(argv[2], argv[3], argv[4], argv[7]);
+        int to = nodeArg(argv[2], argv[3], argv[4], argv[8]);
+        runCH(argv[2], argv[3], argv[4], argv[5], argv[6], from, to);
+        return 0;
+    }
+    else if (argc > 7 && strcmp(argv[1], "astar") == 0)
+    {
+        int from = nodeArg(argv[2], argv[3], argv[4], argv[6]);
+        int to = nodeArg(argv[2], argv[3], argv[4], argv[7]);
+        shortestPath(argv[2], argv[3], argv[4], NULL, argv[5], MODE_ASTAR, from, to);
+        return 0;
+    }
+    else if (argc > 5 && strcmp(argv[1], "compare") == 0)
+    {
+        int queries = argc > 6 ? atoi(argv[6]) : 100;
+        runCompare(argv[2], argv[3], argv[4], argv[5], queries);
+        return 0;
+    }
+    else if (argc > 7 && strcmp(argv[1], "bidi") == 0)
+    {
+        int from = nodeArg(argv[2], argv[3], argv[4], argv[6]);
+        int to = nodeArg(argv[2], argv[3], argv[4], argv[7]);
+        shortestPath(argv[2], argv[3], argv[4], NULL, argv[5], MODE_BIDI, from, to);
+        return 0;
+    }
     else if (argc > 8 && strcmp(argv[1], "alt") == 0)
     {
-        int from = atoi(argv[7]);
-        int to = atoi(argv[8]);
+        int from = nodeArg(argv[2], argv[3], argv[4], argv[7]);
+        int to = nodeArg(argv[2], argv[3], argv[4], argv[8]);
         shortestPath(argv[2], argv[3], argv[4], argv[5], argv[6], MODE_ALT, from, to);
         return 0;
     }
+    else if (argc > 8 && strcmp(argv[1], "balt") == 0)
+    {
+        int from = nodeArg(argv[2], argv[3], argv[4], argv[7]);
+        int to = nodeArg(argv[2], argv[3], argv[4], argv[8]);
+        shortestPath(argv[2], argv[3], argv[4], argv[5], argv[6], MODE_BIDI_ALT, from, to);
+        return 0;
+    }
+    else if (argc > 5 && strcmp(argv[1], "station-pre") == 0)
+    {
+        stationPreProcess(argv[2], argv[3], argv[4], argv[5]);
+        return 0;
+    }
+    else if (argc > 10 && strcmp(argv[1], "detour") == 0 && atoi(argv[8]) > 0 &&
+             (strcmp(argv[7], "fuel") == 0 || strcmp(argv[7], "charger") == 0))
+    {
+        char mode = strcmp(argv[7], "charger") == 0 ? MODE_CHARGER : MODE_FUEL;
+        int n = atoi(argv[8]);
+        int from = nodeArg(argv[2], argv[3], argv[4], argv[9]);
+        int to = nodeArg(argv[2], argv[3], argv[4], argv[10]);
+        runDetourStations(argv[2], argv[3], argv[4], argv[5], argv[6], mode, n, from, to);
+        return 0;
+    }
+    else if (argc > 7 && strcmp(argv[1], "iso") == 0)
+    {
+        int node = nodeArg(argv[2], argv[3], argv[4], argv[6]);
+        runIsochrone(argv[2], argv[3], argv[4], argv[5], node, atoi(argv[7]),
+                     argv + 8, argc - 8);
+        return 0;
+    }
+    else if (argc > 7 && strcmp(argv[1], "nearest") == 0)
+    {
+        char mode = strcmp(argv[6], "charger") == 0 ? MODE_CHARGER : MODE_FUEL;
+        int node = nodeArg(argv[2], argv[3], argv[4], argv[7]);
+        runNearestStation(argv[2], argv[3], argv[4], argv[5], mode, node);
+        return 0;
+    }
     else if (argc > 7 && (strcmp(argv[1], "fuel") == 0 || strcmp(argv[1], "charger") == 0))
     {
         int n = atoi(argv[6]);
-        int node = atoi(argv[7]);
+        int node = nodeArg(argv[2], argv[3], argv[4], argv[7]);
         char mode = strcmp(argv[1], "fuel") == 0 ? MODE_FUEL : MODE_CHARGER;
 
         runFindStations(argv[2], argv[3], argv[4], argv[5], mode, n, node);
@@ -873,6 +5250,10 @@ int main(int argc, char *argv[])
         char norEdge[] = "norden/kanter.txt";
         char norPoi[] = "norden/interessepkt.txt";
         char norPre[] = "pre-norden";
+        char iceCH[] = "ch-ice";
+        char norCH[] = "ch-norden";
+        char iceGraph[] = "ice.graph";
+        char norGraph[] = "norden.graph";
         char pathFile[] = "path.csv";
         char stationsFile[] = "stations.csv";
 
@@ -898,6 +5279,15 @@ int main(int argc, char *argv[])
         int snaasa = 5379848;
         int mehamn = 2951840;
 
+        if (strcmp(argv[1], "tconv1") == 0)
+            convertGraph(iceNode, iceEdge, icePoi, iceGraph);
+        if (strcmp(argv[1], "tconv2") == 0)
+            convertGraph(norNode, norEdge, norPoi, norGraph);
+        if (strcmp(argv[1], "tsnap1") == 0)
+            shortestPath(iceGraph, "-", "-", NULL, pathFile, MODE_DJIKSTRA, reykjavik, selfoss);
+        if (strcmp(argv[1], "tsnap9a") == 0)
+            shortestPath(norGraph, "-", "-", NULL, pathFile, MODE_DJIKSTRA, nordkapp, trondheim);
+
         if (strcmp(argv[1], "ti1") == 0)
             shortestPath(iceNode, iceEdge, icePoi, NULL, pathFile, MODE_DJIKSTRA, reykjavik, selfoss);
 
@@ -924,6 +5314,15 @@ int main(int argc, char *argv[])
         if (strcmp(argv[1], "tr9b") == 0)
             shortestPath(norNode, norEdge, norPoi, NULL, pathFile, MODE_DJIKSTRA, trondheim, nordkapp);
 
+        if (strcmp(argv[1], "tbi1") == 0)
+            shortestPath(iceNode, iceEdge, icePoi, NULL, pathFile, MODE_BIDI, reykjavik, selfoss);
+        if (strcmp(argv[1], "tbi3a") == 0)
+            shortestPath(norNode, norEdge, norPoi, NULL, pathFile, MODE_BIDI, trondheim, oslo);
+        if (strcmp(argv[1], "tbi5a") == 0)
+            shortestPath(norNode, norEdge, norPoi, NULL, pathFile, MODE_BIDI, stavanger, tampere);
+        if (strcmp(argv[1], "tbi9a") == 0)
+            shortestPath(norNode, norEdge, norPoi, NULL, pathFile, MODE_BIDI, nordkapp, trondheim);
+
         if (strcmp(argv[1], "talt2a") == 0)
             shortestPath(norNode, norEdge, norPoi, norPre, pathFile, MODE_ALT, meraaker, stjordal);
         if (strcmp(argv[1], "talt2b") == 0)
@@ -951,31 +5350,60 @@ int main(int argc, char *argv[])
         if (strcmp(argv[1], "talt9b") == 0)
             shortestPath(norNode, norEdge, norPoi, norPre, pathFile, MODE_ALT, trondheim, nordkapp);
 
+        if (strcmp(argv[1], "tbalt3a") == 0)
+            shortestPath(norNode, norEdge, norPoi, norPre, pathFile, MODE_BIDI_ALT, trondheim, oslo);
+        if (strcmp(argv[1], "tbalt4a") == 0)
+            shortestPath(norNode, norEdge, norPoi, norPre, pathFile, MODE_BIDI_ALT, snaasa, mehamn);
+        if (strcmp(argv[1], "tbalt5a") == 0)
+            shortestPath(norNode, norEdge, norPoi, norPre, pathFile, MODE_BIDI_ALT, stavanger, tampere);
+        if (strcmp(argv[1], "tbalt5b") == 0)
+            shortestPath(norNode, norEdge, norPoi, norPre, pathFile, MODE_BIDI_ALT, tampere, stavanger);
+        if (strcmp(argv[1], "tbalt9a") == 0)
+            shortestPath(norNode, norEdge, norPoi, norPre, pathFile, MODE_BIDI_ALT, nordkapp, trondheim);
+        if (strcmp(argv[1], "tbalt9b") == 0)
+            shortestPath(norNode, norEdge, norPoi, norPre, pathFile, MODE_BIDI_ALT, trondheim, nordkapp);
+
+        if (strcmp(argv[1], "tchpre1") == 0)
+            chPreProcess(iceNode, iceEdge, icePoi, iceCH);
+        if (strcmp(argv[1], "tchpre2") == 0)
+            chPreProcess(norNode, norEdge, norPoi, norCH);
+        if (strcmp(argv[1], "tch1") == 0)
+            runCH(iceNode, iceEdge, icePoi, iceCH, pathFile, reykjavik, selfoss);
+        if (strcmp(argv[1], "tch5a") == 0)
+            runCH(norNode, norEdge, norPoi, norCH, pathFile, stavanger, tampere);
+        if (strcmp(argv[1], "tch9a") == 0)
+            runCH(norNode, norEdge, norPoi, norCH, pathFile, nordkapp, trondheim);
+
         if (strcmp(argv[1], "tpre1") == 0)
         {
             int landmarks[] = {nordkapp};
             int m = sizeof(landmarks) / sizeof(int);
-            preProcess(norNode, norEdge, norPoi, norPre, landmarks, m);
+            preProcess(norNode, norEdge, norPoi, norPre, landmarks, m, LANDMARKS_GIVEN, -1);
         }
         if (strcmp(argv[1], "tpre2") == 0)
         {
             int landmarks[] = {nordkapp, tonder, vaalimaa};
             int m = sizeof(landmarks) / sizeof(int);
-            preProcess(norNode, norEdge, norPoi, norPre, landmarks, m);
+            preProcess(norNode, norEdge, norPoi, norPre, landmarks, m, LANDMARKS_GIVEN, -1);
         }
         if (strcmp(argv[1], "tpre3") == 0)
         {
             int landmarks[] = {nordkapp, kvalheim, vaalimaa};
             int m = sizeof(landmarks) / sizeof(int);
-            preProcess(norNode, norEdge, norPoi, norPre, landmarks, m);
+            preProcess(norNode, norEdge, norPoi, norPre, landmarks, m, LANDMARKS_GIVEN, -1);
         }
         if (strcmp(argv[1], "tpre4") == 0)
         {
             int landmarks[] = {nordkapp, kvalheim, tonder, vaalimaa};
             int m = sizeof(landmarks) / sizeof(int);
-            preProcess(norNode, norEdge, norPoi, norPre, landmarks, m);
+            preProcess(norNode, norEdge, norPoi, norPre, landmarks, m, LANDMARKS_GIVEN, -1);
         }
 
+        if (strcmp(argv[1], "tbench1") == 0)
+            benchQueues(iceNode, iceEdge, icePoi, 20);
+        if (strcmp(argv[1], "tbench2") == 0)
+            benchQueues(norNode, norEdge, norPoi, 5);
+
         if (strcmp(argv[1], "tfuel1") == 0)
             runFindStations(iceNode, iceEdge, icePoi, stationsFile, MODE_FUEL, 10, reykjavik);
         if (strcmp(argv[1], "tfuel2") == 0)
@@ -990,13 +5418,5 @@ int main(int argc, char *argv[])
             runFindStations(norNode, norEdge, norPoi, stationsFile, MODE_CHARGER, 10, vaernes);
     }
 
-    printf("usage:\n"
-           "Pre-process ALT: %1$s pre <nodes> <edges> <poi> <out> <landmark> [landmark2..]\n"
-           "Djikstra: %1$s djik <nodes> <edges> <poi> <out> <from> <to>\n"
-           "ALT: %1$s alt <nodes> <edges> <poi> <pre> <out> <from> <to>\n"
-           "Find stations: %1$s fuel|charger <nodes> <edges> <poi> <out> n <node>\n"
-           "Routes will be written to <out> as CSV of nr,node,lat,long\n",
-           argv[0]);
-
-    return 1;
+    return printUsage(argv[0]);
 }
\ No newline at end of file